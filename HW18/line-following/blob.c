@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+
+#include "blob.h"
+
+// connected groups of runs that get their own statistics, the rest are dropped
+#define BLOB_MAX_COMPONENTS 64
+#define NO_COMPONENT 0xFF
+
+// one row's stretch of bright pixels
+typedef struct run{
+    uint8_t row;     // image row
+    uint8_t start;   // first and last column
+    uint8_t end;
+    uint8_t label;   // component, after findBlobs() is done
+    uint16_t parent; // union-find, a root points at itself
+} run_t;
+
+typedef struct component{
+    int area;
+    int sumX, sumY;
+    int left, right, top, bottom;
+} component_t;
+
+static run_t runs[BLOB_MAX_RUNS];
+static int runCount = 0;
+static component_t components[BLOB_MAX_COMPONENTS];
+static blobList_t blobs;
+
+static int findRoot(int i){
+    while (runs[i].parent != i){
+        runs[i].parent = runs[runs[i].parent].parent; // path halving
+        i = runs[i].parent;
+    }
+    return i;
+}
+
+// the lower index stays the root, so a root always comes before its runs
+static void join(int a, int b){
+    a = findRoot(a);
+    b = findRoot(b);
+    if (a < b){
+        runs[b].parent = a;
+    } else if (b < a){
+        runs[a].parent = b;
+    }
+}
+
+// collect the runs of every row and join them to the runs above they touch
+static void labelRuns(const cameraFrame_t *f){
+    uint32_t t0 = time_us_32();
+    int prevStart = 0; // runs of the row above are prevStart .. prevEnd-1
+    int prevEnd = 0;
+    int row;
+    runCount = 0;
+    for(row=0;row<f->rows && !blobs.truncated;row++){
+        if (time_us_32() - t0 > BLOB_BUDGET_US){
+            blobs.truncated = 1;
+            break;
+        }
+        const uint8_t *p = f->data + row*CAM_ROW_BYTES;
+        int rowStart = runCount;
+        int above = prevStart;
+        int i = 0;
+        while (i < IMAGESIZEX){
+            while (i < IMAGESIZEX && pixelBright(p + i*CAM_BYTES_PER_PIXEL) < f->threshold){
+                i++;
+            }
+            if (i == IMAGESIZEX){
+                break;
+            }
+            int start = i;
+            while (i < IMAGESIZEX && pixelBright(p + i*CAM_BYTES_PER_PIXEL) >= f->threshold){
+                i++;
+            }
+            if (runCount == BLOB_MAX_RUNS){
+                // leave this row out whole, blobList_t.truncated says only
+                // the rows before are in
+                runCount = rowStart;
+                blobs.truncated = 1;
+                break;
+            }
+            run_t *r = &runs[runCount];
+            r->row = f->firstRow + row;
+            r->start = start;
+            r->end = i - 1;
+            r->parent = runCount;
+            // 8-connected: any run above reaching from start-1 to end+1
+            while (above < prevEnd && runs[above].end + 1 < r->start){
+                above++;
+            }
+            int a;
+            for(a=above; a<prevEnd && runs[a].start <= r->end + 1; a++){
+                join(runCount, a);
+            }
+            runCount++;
+        }
+        CAM_READ(i*CAM_BYTES_PER_PIXEL);
+        prevStart = rowStart;
+        prevEnd = runCount;
+    }
+}
+
+const blobList_t *findBlobs(const cameraFrame_t *f){
+    blobs.count = 0;
+    blobs.truncated = 0;
+    labelRuns(f);
+
+    // number the components and add up their runs
+    int count = 0;
+    int i;
+    for(i=0;i<runCount;i++){
+        run_t *r = &runs[i];
+        int root = findRoot(i);
+        if (root == i){
+            if (count == BLOB_MAX_COMPONENTS){
+                r->label = NO_COMPONENT;
+                blobs.truncated = 1;
+                continue;
+            }
+            component_t *c = &components[count];
+            c->area = 0;
+            c->sumX = 0;
+            c->sumY = 0;
+            c->left = r->start;
+            c->right = r->end;
+            c->top = r->row;
+            c->bottom = r->row;
+            r->label = count++;
+        } else {
+            r->label = runs[root].label;
+        }
+        if (r->label == NO_COMPONENT){
+            continue;
+        }
+        component_t *c = &components[r->label];
+        int len = r->end - r->start + 1;
+        c->area = c->area + len;
+        c->sumX = c->sumX + (r->start + r->end)*len / 2;
+        c->sumY = c->sumY + r->row*len;
+        if (r->start < c->left) c->left = r->start;
+        if (r->end > c->right) c->right = r->end;
+        if (r->row > c->bottom) c->bottom = r->row;
+    }
+
+    // keep the BLOB_MAX biggest that aren't noise
+    for(i=0;i<count;i++){
+        component_t *c = &components[i];
+        if (c->area < BLOB_MIN_AREA){
+            continue;
+        }
+        blob_t *b;
+        if (blobs.count < BLOB_MAX){
+            b = &blobs.blob[blobs.count++];
+        } else {
+            b = &blobs.blob[0];
+            int k;
+            for(k=1;k<BLOB_MAX;k++){
+                if (blobs.blob[k].area < b->area) b = &blobs.blob[k];
+            }
+            if (b->area >= c->area){
+                continue;
+            }
+        }
+        b->area = c->area;
+        b->left = c->left;
+        b->right = c->right;
+        b->top = c->top;
+        b->bottom = c->bottom;
+        b->cx = REAL_FRAC(c->sumX, c->area);
+        b->cy = REAL_FRAC(c->sumY, c->area);
+        b->label = i;
+    }
+    return &blobs;
+}
+
+const blob_t *pickTrackBlob(const blobList_t *b, real_t lastRow){
+    const blob_t *best = NULL;
+    real_t bestDist = 0;
+    int i;
+    for(i=0;i<b->count;i++){
+        const blob_t *c = &b->blob[i];
+        if (lastRow < 0){
+            if (best == NULL || c->area > best->area) best = c;
+        } else {
+            real_t dist = REAL_ABS(c->cy - lastRow);
+            if (best == NULL || dist < bestDist){
+                best = c;
+                bestDist = dist;
+            }
+        }
+    }
+    return best;
+}
+
+int blobFitLine(const blob_t *b, lineFit_t *fit){
+    int x[CAM_FIT_LINES], y[CAM_FIT_LINES];
+    int n = 0;
+    int k, i;
+    for(k=0;k<CAM_FIT_LINES;k++){
+        int col = CAM_FIT_COLUMN(k);
+        int sumRow = 0;
+        int count = 0;
+        // middle of the blob's pixels in this column
+        for(i=0;i<runCount;i++){
+            const run_t *r = &runs[i];
+            if (r->label == b->label && r->start <= col && col <= r->end){
+                sumRow = sumRow + r->row;
+                count++;
+            }
+        }
+        if (count > 0){
+            x[n] = col;
+            y[n] = 16*sumRow / count;
+            n++;
+        }
+    }
+    return fitLinePoints(x, y, n, fit);
+}
@@ -0,0 +1,41 @@
+#ifndef BLOB_h
+#define BLOB_h
+
+#include <stdint.h>
+#include "cam.h"
+
+// Connected regions of pixels over the frame threshold, built from the runs
+// of bright pixels in each row (8-connected). Glare, tape seams and a second
+// line become blobs of their own instead of pulling the line centroid.
+// Everything lives in static pools, nothing is malloc'd.
+
+#define BLOB_MAX_RUNS 512 // bright runs per frame, the search stops when full
+#define BLOB_MAX 16       // blobs kept, the smallest go when there are more
+#define BLOB_MIN_AREA 4   // pixels, anything smaller is noise
+#ifndef BLOB_BUDGET_US
+#define BLOB_BUDGET_US 2000 // no new rows are started after this long
+#endif
+
+typedef struct blob{
+    int area;      // pixels
+    int left, right, top, bottom; // bounding box, image columns and rows, inclusive
+    real_t cx, cy; // centroid, image column and row
+    int label;     // which runs belong to it, for blobFitLine()
+} blob_t;
+
+typedef struct blobList{
+    int count;
+    int truncated; // out of runs or time, only the rows before that are in
+    blob_t blob[BLOB_MAX];
+} blobList_t;
+
+// label the frame, the list and the runs stay valid until the next call
+const blobList_t *findBlobs(const cameraFrame_t *f);
+// the blob continuous with the track from the last frame: the one with its
+// centroid row closest to lastRow (the last fit offset), the biggest if
+// lastRow < 0. NULL if there are no blobs.
+const blob_t *pickTrackBlob(const blobList_t *b, real_t lastRow);
+// fitLine() on only the pixels of one blob
+int blobFitLine(const blob_t *b, lineFit_t *fit);
+
+#endif
@@ -1,10 +1,76 @@
+#include <string.h>
+
 #include "cam.h"
+#include "cam_capture.h"
+#include "cam_stats.h"
+
+// frame ring: the camera fills one slot while the vision code reads another
+static cameraFrame_t frames[CAM_FRAME_SLOTS];
+static cameraFrame_t *capturing = NULL; // slot the camera is writing
+static cameraFrame_t *ready = NULL;     // newest complete frame nobody has taken yet
+static cameraFrame_t *shot = NULL;      // frame from the last setSaveImage()
+static volatile int shotPending = 0;    // shot is done but useFrame() hasn't seen it
+static volatile uint8_t streaming = 0;  // re-arm the capture after every frame
+static volatile uint32_t frameId = 0;
+static volatile uint32_t droppedFrames = 0;
+static uint32_t droppedAtAcquire = 0;
+
+// the frame convertImage() and findLine() work on, and the image rows it holds
+// The frame is complete and owned by the consumer, so plain reads are fine
+static const uint8_t *cameraData = frames[0].data;
+static int dataFirstRow = 0;
+static int dataRows = 0;
+static int dataThreshold = CAM_BRIGHT_MAX + 1; // from the frame histogram
+#if CAM_COUNT_READS
+uint32_t camBytesRead = 0;
+#endif
+
+// band of image rows the sensor is windowed to, see setCameraWindow()
+static int windowFirstRow = (IMAGESIZEY - CAM_BUFFER_ROWS) / 2;
+static int windowRows = CAM_BUFFER_ROWS;
+static int windowChanging = 0; // setCameraWindow() is writing the sensor, don't arm a slot
+
+#if CAM_DEBUG_RGB
+// full RGB copy of cameraData, only for looking at frames on the computer
+static struct cameraImage picture;
+static int pictureTaken = 0; // convertImage() ran on cameraData, the line finders paint on it
+#endif
+
+#if CAM_LUMA_ONLY
+#define pixelBrightLut pixelBright
+#else
+// pixelBright() of RGB565 is the high byte's part plus the low byte's part,
+// two table loads instead of the shifts and masks for every pixel
+static uint16_t brightHigh[256], brightLow[256];
+static int brightTables = 0;
+
+static void brightTablesInit(void){
+    int v;
+    for(v=0;v<256;v++){
+        uint8_t high[2] = {0, (uint8_t)v};
+        uint8_t low[2] = {(uint8_t)v, 0};
+        brightHigh[v] = pixelBright(high);
+        brightLow[v] = pixelBright(low);
+    }
+    brightTables = 1;
+}
+
+static inline int pixelBrightLut(const uint8_t *p){
+    return brightHigh[p[1]] + brightLow[p[0]];
+}
+#endif
+
+#if !CAM_CAPTURE_PIO
+static volatile uint8_t *captureData = frames[0].data;
+static volatile uint32_t captureRows = CAM_BUFFER_ROWS;
 
 void gpio_callback(uint gpio, uint32_t events) {
+    (void)events;
     if (gpio == VS){
         //printf("v\n");
         if (saveImage==1){
             //printf("v\n");
+            cam_frame_start();
             rawIndex = 0;
             hsCount = 0;
             vsCount = 0;
@@ -18,12 +84,13 @@ void gpio_callback(uint gpio, uint32_t events) {
             if (startImage){
                 startCollect = 1;
                 hsCount++;
-                if (hsCount == IMAGESIZEY){
+                if (hsCount > captureRows){
+                    // more rows than asked for but the bytes never added up,
+                    // the PCLK count normally ends the frame before this
                     //printf("%d",hsCount);
-                    saveImage = 0;
                     startImage = 0;
                     startCollect = 0;
-                    hsCount = 0;
+                    cam_frame_complete(hsCount - 1, rawIndex);
                 }
             }
         }
@@ -33,14 +100,16 @@ void gpio_callback(uint gpio, uint32_t events) {
             if(startImage){
                 if(startCollect){
                     vsCount++;
-                    // read the raw data
-                    uint32_t d = gpio_get_all();
-                    cameraData[rawIndex] = d & 0xFF;
-                    rawIndex++;
-                    if (rawIndex == IMAGESIZEX*IMAGESIZEY*2){
-                        saveImage = 0;
+                    // read the raw data, in luma mode only every 2nd byte (Y)
+                    if (!CAM_LUMA_ONLY || (vsCount & 1) == 0){
+                        uint32_t d = gpio_get_all();
+                        captureData[rawIndex] = d & 0xFF;
+                        rawIndex++;
+                    }
+                    if (rawIndex == captureRows*CAM_ROW_BYTES){
                         startImage = 0;
                         startCollect = 0;
+                        cam_frame_complete(hsCount, rawIndex);
                     }
                     if (vsCount == IMAGESIZEX*2){
                         startCollect = 0;
@@ -52,6 +121,281 @@ void gpio_callback(uint gpio, uint32_t events) {
     }
 }
 
+// the GPIO interrupt version of the capture engine just points the ISR at the slot
+void cam_capture_start(volatile uint8_t *dest, uint32_t rows, uint32_t rowBytes){
+    (void)rowBytes; // the ISR writes whole rows of CAM_ROW_BYTES
+    captureData = dest;
+    captureRows = rows;
+    saveImage = 1;
+}
+
+// and forgets it again, the next VS doesn't start anything
+void cam_capture_stop(void){
+    saveImage = 0;
+    startImage = 0;
+    startCollect = 0;
+}
+#endif
+
+// pick a slot for the next frame and start the camera on it,
+// call with interrupts off
+static void startCapture(){
+    if (windowChanging){
+        // setCameraWindow() arms one when the sensor has the new window
+        return;
+    }
+    cameraFrame_t *f = NULL;
+    int i;
+    for(i=0;i<CAM_FRAME_SLOTS;i++){
+        if (frames[i].state == FRAME_FREE){
+            f = &frames[i];
+            break;
+        }
+    }
+    if (f == NULL && ready != NULL){
+        // the consumer is behind, overwrite the frame it never took
+        f = ready;
+        ready = NULL;
+        droppedFrames++;
+        camStats.framesDropped++;
+    }
+    if (f == NULL){
+        // every slot is held by the consumer, releaseFrame() restarts us
+        return;
+    }
+    f->state = FRAME_CAPTURING;
+    f->firstRow = windowFirstRow;
+    f->rows = windowRows;
+    capturing = f;
+    saveImage = 1;
+    cam_capture_start(f->data, f->rows, CAM_ROW_BYTES);
+}
+
+// histogram a lattice over the finished frame, every CAM_HIST_COL_STEP-th
+// pixel of every CAM_HIST_ROW_STEP-th row, on the consumer's side, see cam.h
+static void frameHistogram(cameraFrame_t *f){
+    memset(f->hist, 0, sizeof(f->hist));
+    f->histPixels = 0;
+    int row;
+    for(row=CAM_HIST_ROW_STEP/2;row<f->rows;row+=CAM_HIST_ROW_STEP){
+        const uint8_t *p = f->data + row*CAM_ROW_BYTES;
+        int i;
+        for(i=0;i<IMAGESIZEX;i+=CAM_HIST_COL_STEP){
+            f->hist[pixelBright(p + i*CAM_BYTES_PER_PIXEL) >> CAM_HIST_SHIFT]++;
+        }
+        f->histPixels = f->histPixels + IMAGESIZEX / CAM_HIST_COL_STEP;
+    }
+}
+
+// Otsu: the bin that best splits the histogram into dark floor and bright
+// line, as the lowest brightness counted as line. Floor noise alone also
+// splits somewhere, so the split has to explain most of the brightness
+// variance (one hump split in two leaves much of it inside the halves) and
+// the two sides have to be far apart in brightness, else there is no line
+// in the frame and nothing passes.
+static int otsuThreshold(const uint16_t *hist){
+    uint32_t total = 0;
+    uint32_t sum = 0;
+    uint64_t sumSq = 0;
+    int i;
+    for(i=0;i<CAM_HIST_BINS;i++){
+        total = total + hist[i];
+        sum = sum + i*hist[i];
+        sumSq = sumSq + (uint64_t)(i*i)*hist[i];
+    }
+    uint32_t wB = 0;    // pixels at or below the split
+    uint32_t sumB = 0;
+#if CAM_FIXED_POINT
+    uint64_t bestVar = 0;
+#else
+    float bestVar = 0;
+#endif
+    int best = -1;
+    for(i=0;i<CAM_HIST_BINS-1;i++){
+        wB = wB + hist[i];
+        sumB = sumB + i*hist[i];
+        uint32_t wF = total - wB;
+        if (wB == 0){
+            continue;
+        }
+        if (wF == 0){
+            break;
+        }
+        // between class variance, times total^2
+#if CAM_FIXED_POINT
+        // |d| < 64 bins * 2^13 pixels * 2^13 pixels, d*d fits in 64 bits
+        int64_t d = (int64_t)sumB*total - (int64_t)sum*wB;
+        uint64_t var = (uint64_t)(d*d) / ((uint64_t)wB*wF);
+#else
+        float d = (float)sumB*total - (float)sum*wB;
+        float var = d*d / ((float)wB*wF);
+#endif
+        if (var > bestVar){
+            bestVar = var;
+            best = i;
+        }
+    }
+    if (best < 0){
+        return CAM_BRIGHT_MAX + 1;
+    }
+    // share of the variance the split explains, both times total^2
+    uint64_t totalVar = (uint64_t)total*sumSq - (uint64_t)sum*sum;
+#if CAM_FIXED_POINT
+    if (bestVar*100 < totalVar*CAM_HIST_MIN_SPLIT){
+#else
+    if (bestVar*100 < (float)totalVar*CAM_HIST_MIN_SPLIT){
+#endif
+        return CAM_BRIGHT_MAX + 1;
+    }
+    // class means at the best split, meanF - meanB in brightness units
+    wB = 0;
+    sumB = 0;
+    for(i=0;i<=best;i++){
+        wB = wB + hist[i];
+        sumB = sumB + i*hist[i];
+    }
+    uint32_t wF = total - wB;
+    int64_t apart = ((int64_t)(sum - sumB)*wB - (int64_t)sumB*wF) << CAM_HIST_SHIFT;
+    if (apart < (int64_t)CAM_HIST_MIN_CONTRAST*wB*wF){
+        return CAM_BRIGHT_MAX + 1;
+    }
+    return (best + 1) << CAM_HIST_SHIFT;
+}
+
+// point convertImage() and findLine() at a frame, not from an interrupt
+static void useFrame(cameraFrame_t *f){
+    frameHistogram(f);
+    f->threshold = otsuThreshold(f->hist);
+    cameraData = f->data;
+    dataFirstRow = f->firstRow;
+    dataRows = f->rows;
+    dataThreshold = f->threshold;
+#if !CAM_LUMA_ONLY
+    if (!brightTables){
+        brightTablesInit();
+    }
+#endif
+#if CAM_DEBUG_RGB
+    pictureTaken = 0;
+#endif
+}
+
+// start of frame, only used for timing
+static uint32_t frameStartTime = 0;
+static uint32_t lastCompleteTime = 0;
+
+void cam_frame_start(void){
+    frameStartTime = time_us_32();
+}
+
+// the capture engine finished writing a frame into the capturing slot
+void cam_frame_complete(uint32_t rows, uint32_t bytes){
+    hsCount = rows;
+    rawIndex = bytes;
+    saveImage = 0;
+
+    uint32_t now = time_us_32();
+    if (camStats.firstFrameUs == 0){
+        camStats.firstFrameUs = now; // us since boot
+    }
+    camStats.framesCaptured++;
+    camStats.lastRows = rows;
+    camStats.lastBytes = bytes;
+    if (capturing != NULL && bytes < (uint32_t)capturing->rows*CAM_ROW_BYTES){
+        camStats.framesShort++;
+    }
+    camStatsRecord(STAT_CAPTURE, now - frameStartTime);
+    if (lastCompleteTime != 0){
+        camStatsRecord(STAT_PERIOD, now - lastCompleteTime);
+    }
+    lastCompleteTime = now;
+
+    cameraFrame_t *f = capturing;
+    capturing = NULL;
+    if (f == NULL){
+        return;
+    }
+    f->id = frameId++;
+    f->bytes = bytes;
+    f->timestamp = now;
+
+    if (!streaming){
+        // single shot from setSaveImage(), getSaveImage() hands it to
+        // convertImage() once the caller sees it done
+        if (shot != NULL){
+            shot->state = FRAME_FREE;
+        }
+        f->state = FRAME_IN_USE;
+        shot = f;
+        shotPending = 1;
+        return;
+    }
+
+    if (ready != NULL){
+        // newer frame arrived before the old one was taken
+        ready->state = FRAME_FREE;
+        droppedFrames++;
+        camStats.framesDropped++;
+    }
+    f->state = FRAME_READY;
+    ready = f;
+    startCapture();
+}
+
+// capture continuously into the frame ring, take frames with acquireFrame()
+void startFrameStream(){
+    uint32_t save = save_and_disable_interrupts();
+    streaming = 1;
+    if (shot != NULL){
+        shot->state = FRAME_FREE;
+        shot = NULL;
+        shotPending = 0;
+    }
+    if (capturing == NULL){
+        startCapture();
+    }
+    restore_interrupts(save);
+}
+
+// stop after the frame currently being captured
+void stopFrameStream(){
+    streaming = 0;
+}
+
+// newest complete frame, or NULL if the camera hasn't finished one since the last call
+// convertImage() and findLine() use this frame until the next acquireFrame()
+cameraFrame_t *acquireFrame(){
+    uint32_t save = save_and_disable_interrupts();
+    cameraFrame_t *f = ready;
+    if (f != NULL){
+        ready = NULL;
+        f->state = FRAME_IN_USE;
+        f->dropped = droppedFrames - droppedAtAcquire;
+        droppedAtAcquire = droppedFrames;
+    }
+    restore_interrupts(save);
+    if (f != NULL){
+        // the slot is ours now, the threshold can be worked out with interrupts on
+        useFrame(f);
+    }
+    return f;
+}
+
+// give the slot back to the camera
+void releaseFrame(cameraFrame_t *f){
+    uint32_t save = save_and_disable_interrupts();
+    f->state = FRAME_FREE;
+    if (streaming && capturing == NULL){
+        startCapture();
+    }
+    restore_interrupts(save);
+}
+
+// total frames thrown away because the consumer was busy
+uint32_t getDroppedFrames(){
+    return droppedFrames;
+}
+
 // setup the camera pins
 void init_camera_pins(){
     // 8 data pins
@@ -90,6 +434,7 @@ void init_camera_pins(){
     pwm_set_enabled(slice_num, true); // turn on the PWM
     pwm_set_gpio_level(MCLK, wrap / 2); // set the duty cycle to 50%
 
+#if !CAM_FAST_INIT
     sleep_ms(1000); // give the camera time to get going
 
     // powerdown and restart
@@ -97,33 +442,42 @@ void init_camera_pins(){
     sleep_ms(1);
     gpio_put(PWDN, 0);
     sleep_ms(1000);
+#endif
+    // with CAM_FAST_INIT PWDN has been low since power up and the
+    // RST pulse in init_camera() is enough to start from a known state
 
-    // I2C Initialisation. Using it at 100Khz.
-    i2c_init(I2C_PORT, 100*1000);
+    // I2C Initialisation, SCCB is fine at 400Khz
+    i2c_init(I2C_PORT, CAM_I2C_BAUD);
     gpio_set_function(I2C_SDA, GPIO_FUNC_I2C);
     gpio_set_function(I2C_SCL, GPIO_FUNC_I2C);
     gpio_pull_up(I2C_SDA);
     gpio_pull_up(I2C_SCL);
     
     printf("Start init camera\n");
+    uint32_t t0 = time_us_32();
     init_camera();
-    printf("End init camera\n");
+    camStats.initUs = time_us_32() - t0;
+    printf("End init camera %lu us\n", (unsigned long)camStats.initUs);
 
-    // interrupts
     gpio_init(VS); // vertical sync
     gpio_set_dir(VS, GPIO_IN);
-    // new image starts on falling VS
-    gpio_set_irq_enabled_with_callback(VS, GPIO_IRQ_EDGE_FALL, true, &gpio_callback);
-
     gpio_init(HS); // horizontal sync
     gpio_set_dir(HS, GPIO_IN);
-    // new row starts on rising HS
-    gpio_set_irq_enabled_with_callback(HS, GPIO_IRQ_EDGE_RISE, true, &gpio_callback);
-
     gpio_init(PCLK); // pixel clock
     gpio_set_dir(PCLK, GPIO_IN);
+
+#if CAM_CAPTURE_PIO
+    // PIO samples the bytes, DMA stores them, one interrupt per frame
+    cam_capture_init();
+#else
+    // interrupts
+    // new image starts on falling VS
+    gpio_set_irq_enabled_with_callback(VS, GPIO_IRQ_EDGE_FALL, true, &gpio_callback);
+    // new row starts on rising HS
+    gpio_set_irq_enabled_with_callback(HS, GPIO_IRQ_EDGE_RISE, true, &gpio_callback);
     // read byte on rising PCLK
     gpio_set_irq_enabled_with_callback(PCLK, GPIO_IRQ_EDGE_RISE, true, &gpio_callback);
+#endif
 }
 
 // init the camera with RST and I2C commands
@@ -132,27 +486,45 @@ void init_camera(){
     gpio_put(RST, 0);
     sleep_ms(1);
     gpio_put(RST, 1);
+#if CAM_FAST_INIT
+    // the hardware reset already cleared the registers, just wait until
+    // the sensor answers on the bus instead of a fixed delay
+    int tries;
+    for(tries=0; tries<CAM_PROBE_TRIES; tries++){
+        sleep_ms(1);
+        uint8_t reg = OV7670_REG_PID;
+        uint8_t id;
+        if (i2c_write_blocking(I2C_PORT, OV7670_ADDR, &reg, 1, false) == 1 &&
+            i2c_read_blocking(I2C_PORT, OV7670_ADDR, &id, 1, false) == 1 &&
+            id == 0x76){
+            break;
+        }
+    }
+    if (tries == CAM_PROBE_TRIES){
+        printf("camera not answering on I2C\n");
+    }
+#else
     sleep_ms(1000);
 
     OV7670_write_register(0x12, 0x80); // software reset
     sleep_ms(1000);
+#endif
 
     // perform all the I2C writes for init
     // 25MHz * PLL / divisor = 24MHz for 30fps -> actually only 5fps
     OV7670_write_register(OV7670_REG_CLKRC, 1); // div 1
     OV7670_write_register(OV7670_REG_DBLV, 0); // no pll
 
-    int i = 0;
-
     // init regular registers
-    for(i=0; i<92; i++){
-        OV7670_write_register(OV7670_init[i][0],OV7670_init[i][1]);
-    }
+    OV7670_write_table(OV7670_init);
 
+#if CAM_LUMA_ONLY
+    // set colorspace to YUV422, the capture keeps the Y bytes
+    OV7670_write_table(OV7670_yuv);
+#else
     // set colorspace to RGB565
-    for(i=0; i<12; i++){
-        OV7670_write_register(OV7670_rgb[i][0],OV7670_rgb[i][1]);
-    }
+    OV7670_write_table(OV7670_rgb);
+#endif
 
     // init image size
     
@@ -167,10 +539,7 @@ void init_camera(){
 
     uint8_t value;
     uint8_t size = OV7670_SIZE_DIV8; // 80x60
-    uint16_t vstart = 12;
-    uint16_t hstart = 210;
-    uint16_t edge_offset = 0;
-    uint16_t pclk_delay = 2;
+    uint16_t pclk_delay = CAM_PCLK_DELAY;
 
     // Enable downsampling if sub-VGA, and zoom if 1:16 scale
     value = (size > OV7670_SIZE_DIV1) ? OV7670_COM3_DCWEN : 0;
@@ -205,19 +574,16 @@ void init_camera(){
     OV7670_write_register(OV7670_REG_SCALING_XSC, xsc);
     OV7670_write_register(OV7670_REG_SCALING_YSC, ysc);
 
-    // Window size is scattered across multiple registers.
-    // Horiz/vert stops can be automatically calc'd from starts.
-    uint16_t vstop = vstart + 480;
-    uint16_t hstop = (hstart + 640) % 784;
-    OV7670_write_register(OV7670_REG_HSTART, hstart >> 3);
-    OV7670_write_register(OV7670_REG_HSTOP, hstop >> 3);
-    OV7670_write_register(OV7670_REG_HREF,(edge_offset << 6) | ((hstop & 0b111) << 3) | (hstart & 0b111));
-    OV7670_write_register(OV7670_REG_VSTART, vstart >> 2);
-    OV7670_write_register(OV7670_REG_VSTOP, vstop >> 2);
-    OV7670_write_register(OV7670_REG_VREF, ((vstop & 0b11) << 2) | (vstart & 0b11));
+    // Window size is scattered across multiple registers,
+    // setCameraWindow() works out the vertical band from vstart and hstart
+    setCameraWindow(windowFirstRow, windowRows);
     OV7670_write_register(OV7670_REG_SCALING_PCLK_DELAY, pclk_delay);
 
+#if !CAM_FAST_INIT
     sleep_ms(300); // allow camera to settle with new settings 
+#endif
+    // with CAM_FAST_INIT the first frames may still have AEC/AWB settling,
+    // the capture side doesn't care and the line threshold follows the frame
 
     //OV7670_test_pattern(OV7670_TEST_PATTERN_NONE);
     //OV7670_test_pattern(OV7670_TEST_PATTERN_COLOR_BAR);
@@ -230,6 +596,61 @@ void init_camera(){
     printf("ver = %d (115)\n",v);
 }
 
+// Only deliver image rows firstRow to firstRow+rows-1, rows can be at most CAM_BUFFER_ROWS.
+// The sensor stops sending HS/PCLK after the band, so the capture finishes early
+// and each frame slot only has to hold the band.
+// A capture already armed with the old band (streaming, or a single shot in
+// progress) is dropped, the registers written, and the slot armed again with
+// the new band. The sensor switches at its next frame, which is the one the
+// new capture waits for, so every frame is labelled with the band it holds.
+void setCameraWindow(int firstRow, int rows){
+    if (rows > CAM_BUFFER_ROWS) rows = CAM_BUFFER_ROWS;
+    if (rows < 1) rows = 1;
+    if (firstRow < 0) firstRow = 0;
+    if (firstRow + rows > IMAGESIZEY) firstRow = IMAGESIZEY - rows;
+
+    uint32_t save = save_and_disable_interrupts();
+    windowChanging = 1;
+    int rearm = capturing != NULL;
+    if (rearm){
+        cam_capture_stop();
+        capturing->state = FRAME_FREE;
+        capturing = NULL;
+    }
+    restore_interrupts(save);
+
+    // full frame window from init_camera(): vstart 12 .. vstart+480 VGA lines,
+    // at 1:8 downsampling every image row is 8 of those lines
+    uint16_t vstart = CAM_VSTART + firstRow*CAM_LINES_PER_ROW;
+    uint16_t vstop = vstart + rows*CAM_LINES_PER_ROW;
+    uint16_t hstart = CAM_HSTART;
+    uint16_t edge_offset = CAM_EDGE_OFFSET;
+
+    // Horiz/vert stops can be automatically calc'd from starts.
+    uint16_t hstop = (hstart + 640) % 784;
+    OV7670_write_register(OV7670_REG_HSTART, hstart >> 3);
+    OV7670_write_register(OV7670_REG_HSTOP, hstop >> 3);
+    OV7670_write_register(OV7670_REG_HREF,(edge_offset << 6) | ((hstop & 0b111) << 3) | (hstart & 0b111));
+    OV7670_write_register(OV7670_REG_VSTART, vstart >> 2);
+    OV7670_write_register(OV7670_REG_VSTOP, vstop >> 2);
+    OV7670_write_register(OV7670_REG_VREF, ((vstop & 0b11) << 2) | (vstart & 0b11));
+
+    save = save_and_disable_interrupts();
+    windowFirstRow = firstRow;
+    windowRows = rows;
+    windowChanging = 0;
+    if ((rearm || streaming) && capturing == NULL){
+        startCapture();
+    }
+    restore_interrupts(save);
+}
+
+// band of rows the camera is currently windowed to
+void getCameraWindow(int *firstRow, int *rows){
+    *firstRow = windowFirstRow;
+    *rows = windowRows;
+}
+
 // Selects one of the camera's test patterns (or disable).
 // See Adafruit_OV7670.h for notes about minor visual bug here.
 void OV7670_test_pattern(OV7670_pattern pattern) {
@@ -258,7 +679,18 @@ void OV7670_write_register(uint8_t reg, uint8_t value){
     buf[0] = reg;
     buf[1] = value;
     i2c_write_blocking(I2C_PORT, OV7670_ADDR, buf, 2, false);
+#if !CAM_FAST_INIT
     sleep_ms(1); // after each
+#endif
+}
+
+// write {reg, value} pairs up to the {0xff, 0xff} marker back to back,
+// SCCB has no register auto-increment so each pair is its own transaction
+void OV7670_write_table(const uint8_t table[][2]){
+    int i;
+    for(i=0; table[i][0] != 0xff; i++){
+        OV7670_write_register(table[i][0], table[i][1]);
+    }
 }
 
 // I2C read from the camera
@@ -271,118 +703,397 @@ uint8_t OV7670_read_register(uint8_t reg){
 
 // save an image
 void setSaveImage(uint32_t s){
-    saveImage = s;
+    if (s){
+        uint32_t save = save_and_disable_interrupts();
+        if (capturing == NULL){
+            startCapture();
+        }
+        restore_interrupts(save);
+        return;
+    }
+    // 0 stops a running frame stream once the current frame is done
+    stopFrameStream();
 }
 
-// see if you are supposed to be saving an image
+// see if you are supposed to be saving an image. The caller polls this
+// until the shot is done, so the frame's threshold is worked out here, out
+// of the interrupt that finished it
 uint32_t getSaveImage(){
-    return saveImage;
+    cameraFrame_t *f = NULL;
+    // both in one go: the interrupt finishing the shot sets saveImage to 0
+    // and shotPending together, and 0 only goes back once useFrame() has
+    // run on the shot
+    uint32_t save = save_and_disable_interrupts();
+    uint32_t busy = saveImage;
+    if (shotPending){
+        f = shot;
+        shotPending = 0;
+    }
+    restore_interrupts(save);
+    if (f != NULL){
+        useFrame(f);
+    }
+    return busy;
 }
 
-// how many rows were counted, should be IMAGESIZEY
+// how many rows were counted, should be the window height
 uint32_t getHSCount(){
     return hsCount;
 }
 
-// how many pixels were counted times 2, should be 2*IMAGESIZEX*IMAGESIZEY
+// how many pixels were counted times 2, should be 2*IMAGESIZEX*rows
 uint32_t getPixelCount(){
     return rawIndex;
 }
 
-// convert the raw image to RGB
-// https://blog.usedbytes.com/2022/02/pico-pio-camera/
-void convertImage(){
-    picture.index = 0;
-    int i = 0;
-    for(i=0;i<IMAGESIZEX*IMAGESIZEY*2;i=i+2){
-        
-        picture.r[picture.index] = (cameraData[i+1]>>3)<<3;
-        picture.g[picture.index] = (((cameraData[i+1]&0b111)<<3) | cameraData[i]>>5)<<2;
-        picture.b[picture.index] = (cameraData[i]&0b11111)<<3;
-        picture.index++;
+#if CAM_DEBUG_RGB
+// paint n thresholded pixels, stride bytes apart, so printImage() shows
+// what the line finders saw
+static void paintThreshold(int start, int n, int stride){
+    const uint8_t *p = cameraData + start;
+    int index = dataFirstRow*IMAGESIZEX + start / CAM_BYTES_PER_PIXEL;
+    int step = stride / CAM_BYTES_PER_PIXEL;
+    int i;
+    CAM_READ(n*CAM_BYTES_PER_PIXEL);
+    for(i=0;i<n;i++){
+        uint8_t v = (pixelBright(p) >= dataThreshold) ? 255 : 0;
+        picture.r[index] = v;
+        picture.g[index] = v;
+        picture.b[index] = v;
+        index = index + step;
+        p = p + stride;
     }
 }
+#endif
 
-// threshold and then find the center of mass of a row
-int findLine(int row){
-    int pos = 0;
-    int r = row*IMAGESIZEX; // find the index of the start of the row in the pixel array
+// Threshold n pixels, stride bytes apart, against the frame's Otsu threshold
+// and find the center of mass, reading the raw frame only once.
+// weighted = 0 counts every bright pixel the same, 1 weights it by brightness,
+// always a constant so the compiler makes a loop without the test for each.
+// Returns -1 if no pixel made it over the threshold.
+static inline int lineCenter(int start, int n, int stride, int weighted){
+    const uint8_t *p = cameraData + start;
+    int threshold = dataThreshold;
     int sumMass = 0;
-    int sumMassR = 0;
-
+    int sumMassI = 0;
     int i;
 
-    // find the row average brightness
-    int sumBright = 0;
-    for(i=0;i<IMAGESIZEX;i++){
-        sumBright = sumBright + picture.r[r+i] + picture.g[r+i] + picture.b[r+i];
-    }
-    int avgBright = sumBright / IMAGESIZEX;
-
-    // threshold the row
-    for(i=0;i<IMAGESIZEX;i++){
-        int mass = picture.r[r+i] + picture.g[r+i] + picture.b[r+i];
-        if (mass < avgBright){
-            // not bright enough, set pixel to black
-            picture.r[r+i] = 0;
-            picture.g[r+i] = 0;
-            picture.b[r+i] = 0;
-        }
-        else {
-            // set to white
-            picture.r[r+i] = 255;
-            picture.g[r+i] = 255;
-            picture.b[r+i] = 255;
+#if CAM_DEBUG_RGB
+    // only on a frame there is a picture of
+    if (pictureTaken){
+        paintThreshold(start, n, stride);
+    }
+#endif
+    if (threshold > CAM_BRIGHT_MAX){
+        return -1; // nothing is line on this frame
+    }
+    CAM_READ(n*CAM_BYTES_PER_PIXEL);
+    for(i=0;i<n;i++){
+        int b = pixelBrightLut(p);
+        if (b >= threshold){
+            int mass = weighted ? b : 1;
+            sumMass = sumMass + mass;
+            sumMassI = sumMassI + mass*i;
         }
+        p = p + stride;
     }
+    if (sumMass == 0){
+        return -1;
+    }
+    // integer divide, the same as truncating the float center of mass
+    return sumMassI / sumMass;
+}
 
-    // calculate the center of mass of the thresholded row
-    for(i=0;i<IMAGESIZEX;i++){
-        int mass = picture.r[r+i] + picture.g[r+i] + picture.b[r+i];
+#if CAM_LUMA_ONLY
+// lineCenter() for a run of n Y8 pixels starting on a word boundary,
+// 4 pixels per load: one compare for all 4, and whole words below the
+// threshold (most of a row) cost nothing more
+static int lineCenterSwar(int start, int n, int weighted){
+    if (dataThreshold > CAM_BRIGHT_MAX){
+        return -1;
+    }
+    const uint8_t *p = cameraData + start;
+    uint32_t t4 = (uint32_t)dataThreshold * SWAR_ONES;
+    int sumMass = 0;
+    int sumMassI = 0;
+    int i;
+    CAM_READ(n);
+    for(i=0;i+4<=n;i+=4){
+        uint32_t x;
+        memcpy(&x, p + i, 4); // one aligned word load
+        uint32_t ge = swarGE(x, t4);
+        if (ge == 0){
+            continue;
+        }
+        // the pixels themselves, or 1 per pixel, in the lanes over the threshold
+        uint32_t v = weighted ? x & ((ge >> 7) * 0xFF) : ge >> 7;
+        int mass, massI;
+        swarMass(v, &mass, &massI);
         sumMass = sumMass + mass;
-        sumMassR = sumMassR + mass*i;
+        sumMassI = sumMassI + mass*i + massI;
+    }
+    for(;i<n;i++){
+        if (p[i] >= dataThreshold){
+            int mass = weighted ? p[i] : 1;
+            sumMass = sumMass + mass;
+            sumMassI = sumMassI + mass*i;
+        }
+    }
+    if (sumMass == 0){
+        return -1;
     }
-    float centerOfMass = (float)sumMassR / sumMass;
-    return (int)(centerOfMass);
+    return sumMassI / sumMass;
 }
+#endif
 
+// threshold and then find the center of mass of a row
+int findLine(int row){
+    row = row - dataFirstRow; // the frame only holds the window rows
+    if (row < 0 || row >= dataRows) return IMAGESIZEX / 2;
+#if CAM_SWAR
+    int com = lineCenterSwar(row*CAM_ROW_BYTES, IMAGESIZEX, 0);
+#else
+    int com = lineCenter(row*CAM_ROW_BYTES, IMAGESIZEX, CAM_BYTES_PER_PIXEL, 0);
+#endif
+    if (com < 0) return IMAGESIZEX / 2; // fallback to center
+    return com;
+}
+
+// threshold and then find the brightness weighted center of mass of a column
 int findLineColumn(int col){
-    int sumBright = 0;
-    int sumMass = 0;
-    int sumMassY = 0;
+    int com = lineCenter(col*CAM_BYTES_PER_PIXEL, dataRows, CAM_ROW_BYTES, 1);
+    if (com < 0) return IMAGESIZEY / 2; // fallback to center
+    return dataFirstRow + com;
+}
+
+// integer square root, for the fit residual
+static uint32_t isqrt(uint32_t v){
+    uint32_t r = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > v){
+        bit >>= 2;
+    }
+    while (bit){
+        if (v >= r + bit){
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return r;
+}
+
+// Find the line on CAM_FIT_LINES columns and least squares fit a line through
+// them, so the controller gets the heading and not just one position.
+// The band is read once, row by row, picking up every column on the way.
+// Returns the number of columns that saw the line, 0 leaves the fit at the
+// image center with quality 0.
+int fitLine(lineFit_t *fit){
+    const uint8_t *p = cameraData;
+    int sumMass[CAM_FIT_LINES] = {0};
+    int sumMassI[CAM_FIT_LINES] = {0};
+    int cols[CAM_FIT_LINES];
+    int k, r;
 
-    // Compute average brightness in the column
-    for (int row = 0; row < IMAGESIZEY; row++) {
-        int index = row * IMAGESIZEX + col;
-        int brightness = picture.r[index] + picture.g[index] + picture.b[index];
-        sumBright += brightness;
+    for(k=0;k<CAM_FIT_LINES;k++){
+        cols[k] = CAM_FIT_COLUMN(k);
+    }
+    // brightness weighted center of mass of each column
+    CAM_READ(dataRows*CAM_FIT_LINES*CAM_BYTES_PER_PIXEL);
+    for(r=0;r<dataRows;r++){
+        for(k=0;k<CAM_FIT_LINES;k++){
+            int b = pixelBright(p + cols[k]*CAM_BYTES_PER_PIXEL);
+            if (b >= dataThreshold){
+                sumMass[k] = sumMass[k] + b;
+                sumMassI[k] = sumMassI[k] + b*r;
+            }
+        }
+        p = p + CAM_ROW_BYTES;
     }
 
-    int avgBright = sumBright / IMAGESIZEY;
+    // columns that saw the line, centers in 1/16 rows
+    int n = 0;
+    int x[CAM_FIT_LINES], y[CAM_FIT_LINES];
+    for(k=0;k<CAM_FIT_LINES;k++){
+        if (sumMass[k] > 0){
+            x[n] = cols[k];
+            y[n] = (dataFirstRow*16) + (sumMassI[k]*16) / sumMass[k];
+            n++;
+        }
+    }
+    return fitLinePoints(x, y, n, fit);
+}
 
-    // Threshold the column and compute center of mass
-    for (int row = 0; row < IMAGESIZEY; row++) {
-        int index = row * IMAGESIZEX + col;
-        int brightness = picture.r[index] + picture.g[index] + picture.b[index];
+// Scan only a window around the predicted line on each fit column: samples
+// CAM_SPARSE_STEP rows apart find the line, then every pixel from one step
+// before the first hit to one step after the last gives its exact center.
+// A frame where the line is where it was costs about
+// CAM_FIT_LINES*(2*CAM_SPARSE_WINDOW/CAM_SPARSE_STEP + line width) pixels
+// instead of CAM_FIT_LINES*rows.
+int fitLineNear(lineFit_t *fit, real_t row, real_t slope, real_t curvature){
+    int x[CAM_FIT_LINES], y[CAM_FIT_LINES];
+    int n = 0;
+    int misses = 0;
+    int k, r;
 
-        if (brightness < avgBright) {
-            picture.r[index] = 0;
-            picture.g[index] = 0;
-            picture.b[index] = 0;
-        } else {
-            picture.r[index] = 255;
-            picture.g[index] = 255;
-            picture.b[index] = 255;
+    // row is where the fitted line crosses the middle column, and a bent
+    // line sits above it there by curvature times the mean of dx*dx
+    int bend = 0;
+    for(k=0;k<CAM_FIT_LINES;k++){
+        int dx = CAM_FIT_COLUMN(k) - IMAGESIZEX/2;
+        bend = bend + dx*dx;
+    }
+    bend = bend / CAM_FIT_LINES;
+
+    for(k=0;k<CAM_FIT_LINES;k++){
+        int col = CAM_FIT_COLUMN(k);
+        int dx = col - IMAGESIZEX/2;
+        // window in band rows, the band starts at image row dataFirstRow
+        int center = REAL_TO_INT(row + slope*dx + curvature*(dx*dx - bend)) - dataFirstRow;
+        int lo = center - CAM_SPARSE_WINDOW;
+        int hi = center + CAM_SPARSE_WINDOW;
+        if (lo < 0) lo = 0;
+        if (hi > dataRows - 1) hi = dataRows - 1;
+        const uint8_t *p = cameraData + col*CAM_BYTES_PER_PIXEL;
 
-            sumMass += brightness;
-            sumMassY += brightness * row;
+        // coarse pass
+        int first = -1, last = -1;
+        if (hi >= lo){
+            CAM_READ(((hi - lo) / CAM_SPARSE_STEP + 1)*CAM_BYTES_PER_PIXEL);
+        }
+        for(r=lo;r<=hi;r+=CAM_SPARSE_STEP){
+            if (pixelBright(p + r*CAM_ROW_BYTES) >= dataThreshold){
+                if (first < 0) first = r;
+                last = r;
+            }
+        }
+        if (first < 0){
+            if (++misses > CAM_SPARSE_MAX_MISSES){
+                return 0; // early exit, the line moved or is gone
+            }
+            continue;
         }
+
+        // fine pass around the hits
+        int from = first - CAM_SPARSE_STEP + 1;
+        int to = last + CAM_SPARSE_STEP - 1;
+        if (from < lo) from = lo;
+        if (to > hi) to = hi;
+        int sumMass = 0, sumMassI = 0;
+        int runs = 0, inRun = 0;
+        CAM_READ((to - from + 1)*CAM_BYTES_PER_PIXEL);
+        for(r=from;r<=to;r++){
+            int b = pixelBright(p + r*CAM_ROW_BYTES);
+            if (b >= dataThreshold){
+                // the line runs on past the window, a full scan sees all of it
+                if ((r == lo && lo > 0) || (r == hi && hi < dataRows - 1)){
+                    return 0;
+                }
+                // a second run is glare or another line next to this one,
+                // which of them is the track takes the full scan
+                if (!inRun && ++runs > 1){
+                    return 0;
+                }
+                inRun = 1;
+                sumMass = sumMass + b;
+                sumMassI = sumMassI + b*r;
+            } else {
+                inRun = 0;
+            }
+        }
+        x[n] = col;
+        y[n] = (dataFirstRow*16) + (sumMassI*16) / sumMass;
+        n++;
     }
+    return fitLinePoints(x, y, n, fit);
+}
 
-    if (sumMass == 0) return IMAGESIZEY / 2; // fallback to center
+// least squares fit of row = a + b*col through n points, x in columns and y
+// in 1/16 rows, and fill in fit like fitLine() does. Returns n.
+int fitLinePoints(const int *x, const int *y, int n, lineFit_t *fit){
+    int k;
+    fit->points = n;
+    fit->heading = 0;
+    fit->slope = 0;
+    fit->quality = 0;
+    fit->curvature = 0;
+    if (n == 0){
+        fit->offset = REAL_FROM_INT(IMAGESIZEY / 2); // fallback to center
+        return 0;
+    }
 
-    float centerOfMass = (float)sumMassY / sumMass;
-    return (int)centerOfMass;
+    // integer least squares, row = a + b*col
+    int32_t sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for(k=0;k<n;k++){
+        sx = sx + x[k];
+        sy = sy + y[k];
+        sxx = sxx + x[k]*x[k];
+        sxy = sxy + x[k]*y[k];
+    }
+    int32_t num = n*sxy - sx*sy; // b = num / den, in 1/16 rows per column
+    int32_t den = n*sxx - sx*sx;
+    if (den == 0){
+        // a single column, no heading
+        fit->offset = REAL_FRAC(sy, 16*n);
+        fit->quality = 100*n / CAM_FIT_LINES;
+        return n;
+    }
+    // row at the image center column, and the squared residuals around the fit
+    int xc = IMAGESIZEX / 2;
+    int64_t yc = ((int64_t)sy*den + (int64_t)num*(n*xc - sx)) / ((int64_t)n*den);
+    int64_t sse = 0;
+    int64_t sed2 = 0, s1 = 0, s2 = 0, s3 = 0, s4 = 0;
+    for(k=0;k<n;k++){
+        int64_t d = x[k] - xc;
+        int64_t e = y[k] - yc - ((int64_t)num*d) / den;
+        sse = sse + e*e;
+        sed2 = sed2 + e*d*d;
+        s1 = s1 + d;
+        s2 = s2 + d*d;
+        s3 = s3 + d*d*d;
+        s4 = s4 + d*d*d*d;
+    }
+    fit->offset = REAL_FRAC(yc, 16);
+    fit->slope = REAL_FRAC(num, 16*den);
+    // the bend, the residuals fitted on the part of d*d a line can't follow,
+    // d = col - IMAGESIZEX/2, times n*den
+    int64_t qq = n*den*s4 - den*s2*s2 - (n*s3 - s1*s2)*(n*s3 - s1*s2);
+    if (n >= 3 && qq > 0){
+        fit->curvature = REAL_FRAC(sed2*n*den, 16*qq);
+    }
+    fit->heading = REAL_ATAN(fit->slope);
+    // lose 10 points per row of rms residual, 10*rms = sqrt(100*sse/n)/16
+    uint64_t ms = (uint64_t)(100*sse) / n;
+    int quality = 100*n / CAM_FIT_LINES - (int)(isqrt(ms > UINT32_MAX ? UINT32_MAX : (uint32_t)ms) / 16);
+    fit->quality = quality < 0 ? 0 : quality;
+    return n;
+}
+
+#if CAM_DEBUG_RGB
+// convert the raw image to RGB
+// https://blog.usedbytes.com/2022/02/pico-pio-camera/
+void convertImage(){
+    uint32_t t0 = time_us_32();
+    picture.index = dataFirstRow*IMAGESIZEX;
+    int i = 0;
+    CAM_READ(CAM_ROW_BYTES*dataRows);
+    for(i=0;i<CAM_ROW_BYTES*dataRows;i=i+CAM_BYTES_PER_PIXEL){
+#if CAM_LUMA_ONLY
+        // gray, Y in all three
+        picture.r[picture.index] = cameraData[i];
+        picture.g[picture.index] = cameraData[i];
+        picture.b[picture.index] = cameraData[i];
+#else
+        picture.r[picture.index] = (cameraData[i+1]>>3)<<3;
+        picture.g[picture.index] = (((cameraData[i+1]&0b111)<<3) | cameraData[i]>>5)<<2;
+        picture.b[picture.index] = (cameraData[i]&0b11111)<<3;
+#endif
+        picture.index++;
+    }
+    pictureTaken = 1;
+    camStatsRecord(STAT_CONVERT, time_us_32() - t0);
 }
 
 // change the color of a pixel for visualization purposes
@@ -393,6 +1104,14 @@ void setPixel(int row, int col, uint8_t r, uint8_t g, uint8_t b){
     picture.b[index] = b;
 }
 
+// color of a pixel after convertImage() and setPixel()
+void getPixel(int row, int col, uint8_t *r, uint8_t *g, uint8_t *b){
+    int index = row*IMAGESIZEX+col;
+    *r = picture.r[index];
+    *g = picture.g[index];
+    *b = picture.b[index];
+}
+
 // print out the image to computer
 void printImage(){
     int i = 0;
@@ -400,3 +1119,4 @@ void printImage(){
         printf("%d %d %d %d\r\n", i, picture.r[i], picture.g[i], picture.b[i]);
     }
 }
+#endif
@@ -6,7 +6,9 @@
 #include "hardware/i2c.h"
 #include "hardware/gpio.h"
 #include "hardware/pwm.h"
+#include "hardware/sync.h"
 #include "ov7670.h"
+#include "fixed_point.h"
 
 // I2C defines
 #define I2C_PORT i2c1
@@ -39,17 +41,98 @@
 // RGB565 example:
 // https://blog.usedbytes.com/2022/02/pico-pio-camera/
 
+// 1 to capture with PIO + DMA (cam_capture.pio), 0 for the old per-PCLK GPIO interrupt
+#ifndef CAM_CAPTURE_PIO
+#define CAM_CAPTURE_PIO 1
+#endif
+
+// 1 for the quick bring-up: 400kHz I2C, no fixed sleeps, the sensor is polled
+// until it answers; 0 for the original ~3.5s sequence of resets and delays
+#ifndef CAM_FAST_INIT
+#define CAM_FAST_INIT 1
+#endif
+#if CAM_FAST_INIT
+#define CAM_I2C_BAUD (400*1000)
+#define CAM_PROBE_TRIES 100 // 1ms apart, the sensor answers within a few ms of RST
+#else
+#define CAM_I2C_BAUD (100*1000)
+#endif
+
 void init_camera_pins();
 void init_camera();
 void setSaveImage(uint32_t);
 uint32_t getSaveImage();
 uint32_t getHSCount();
 uint32_t getPixelCount();
-void convertImage();
-void printImage();
+void setCameraWindow(int firstRow, int rows);
+void getCameraWindow(int *firstRow, int *rows);
 int findLine(int row);
 int findLineColumn(int col);
+
+// fitLine() takes the line center on this many evenly spaced columns and
+// fits row = a + b*col through them, at most 16
+#ifndef CAM_FIT_LINES
+#define CAM_FIT_LINES 5
+#endif
+
+typedef struct lineFit{
+    real_t offset;  // image row of the fitted line at column IMAGESIZEX/2
+    real_t heading; // radians, atan of rows per column, + when the line goes to higher rows at higher columns
+    real_t slope;   // rows per column, heading without the atan
+    real_t curvature; // rows per column squared the points bend away from the line, 0 under 3 points
+    int quality;   // 0-100, share of columns that saw the line less the fit residual
+    int points;    // columns that saw the line
+} lineFit_t;
+
+int fitLine(lineFit_t *fit);
+int fitLinePoints(const int *x, const int *y, int n, lineFit_t *fit);
+
+// fitLineNear() only looks CAM_SPARSE_WINDOW rows either side of where the
+// line is expected on each fitLine() column, every CAM_SPARSE_STEP rows,
+// then reads every pixel around the hits. The step has to stay under the
+// line width in rows (about 5 on the track).
+#ifndef CAM_SPARSE_WINDOW
+#define CAM_SPARSE_WINDOW 8
+#endif
+#ifndef CAM_SPARSE_STEP
+#define CAM_SPARSE_STEP 3
+#endif
+// fitLineNear() gives up after this many columns without the line
+#define CAM_SPARSE_MAX_MISSES 1
+
+// fitLine() around the line row + slope*dx bent by curvature*dx*dx,
+// dx = col - IMAGESIZEX/2, e.g. the tracker prediction and the last fit's
+// slope and curvature. Returns 0 with the fit untouched when the line is not
+// where expected (too many columns missed, the line runs into the edge of a
+// window, or a window holds more than one run of line pixels) and the frame
+// needs the full scan.
+int fitLineNear(lineFit_t *fit, real_t row, real_t slope, real_t curvature);
+// the columns fitLine() looks at, k = 0 .. CAM_FIT_LINES-1
+#define CAM_FIT_COLUMN(k) ((2*(k) + 1)*IMAGESIZEX / (2*CAM_FIT_LINES))
+
+// 1 to keep a full RGB copy of the frame (14.4 KB) for printImage(),
+// the line finders work straight from the raw frame either way
+#ifndef CAM_DEBUG_RGB
+#define CAM_DEBUG_RGB 0
+#endif
+#if CAM_DEBUG_RGB
+void convertImage();
+void printImage();
 void setPixel(int row, int col, uint8_t r, uint8_t g, uint8_t b);
+void getPixel(int row, int col, uint8_t *r, uint8_t *g, uint8_t *b);
+#endif
+
+// 1 to count the frame bytes the line finders read in camBytesRead, for
+// vision_bench.c. Counted once per row or column scanned, not per pixel.
+#ifndef CAM_COUNT_READS
+#define CAM_COUNT_READS 0
+#endif
+#if CAM_COUNT_READS
+extern uint32_t camBytesRead;
+#define CAM_READ(bytes) (camBytesRead += (uint32_t)(bytes))
+#else
+#define CAM_READ(bytes) ((void)0)
+#endif
 
 static volatile uint8_t saveImage = 0; // user requests image
 static volatile uint8_t startImage = 0; // got a start of frame
@@ -59,7 +142,136 @@ static volatile uint32_t hsCount = 0;
 static volatile uint32_t vsCount = 0;
 #define IMAGESIZEX 80
 #define IMAGESIZEY 60
-static volatile uint8_t cameraData[IMAGESIZEX*IMAGESIZEY*2];
+
+// 1 to run the camera in YUV422 and keep only the Y byte of each pixel:
+// half the bytes per frame and per pixel, plenty for finding a line.
+// 0 captures RGB565, use it to look at colour images on the computer.
+#ifndef CAM_LUMA_ONLY
+#define CAM_LUMA_ONLY 0
+#endif
+#if CAM_LUMA_ONLY
+#define CAM_BYTES_PER_PIXEL 1
+#else
+#define CAM_BYTES_PER_PIXEL 2
+#endif
+#define CAM_ROW_BYTES (IMAGESIZEX*CAM_BYTES_PER_PIXEL)
+
+// rows each frame slot can hold, less than IMAGESIZEY to only capture a band
+// of the image with setCameraWindow() and save the memory
+#ifndef CAM_BUFFER_ROWS
+#define CAM_BUFFER_ROWS IMAGESIZEY
+#endif
+
+// Window settings were tediously determined empirically.
+//{vstart,hstart,edge_offset,pclk_delay}
+        //{12, 210, 0, 2}, // SIZE_DIV8  80x60
+#define CAM_VSTART 12
+#define CAM_HSTART 210
+#define CAM_EDGE_OFFSET 0
+#define CAM_PCLK_DELAY 2
+#define CAM_LINES_PER_ROW (480/IMAGESIZEY) // VGA lines per image row
+
+// number of raw frames in the capture ring, 2 or 3
+// with 3 the camera never waits: one capturing, one ready, one being processed
+#ifndef CAM_FRAME_SLOTS
+#define CAM_FRAME_SLOTS 3
+#endif
+
+enum {
+    FRAME_FREE = 0,
+    FRAME_CAPTURING,
+    FRAME_READY,
+    FRAME_IN_USE
+};
+
+// frame brightness histogram for the line threshold, pixelBright() >> CAM_HIST_SHIFT
+#if CAM_LUMA_ONLY
+#define CAM_BRIGHT_MAX 255
+#define CAM_HIST_SHIFT 2
+#else
+#define CAM_BRIGHT_MAX (248+252+248)
+#define CAM_HIST_SHIFT 4
+#endif
+#define CAM_HIST_BINS ((CAM_BRIGHT_MAX >> CAM_HIST_SHIFT) + 1)
+// without a line the two Otsu classes are just floor noise: require the
+// split to explain this percentage of the brightness variance (a line on
+// the floor about 95, noise alone under 80) and the class means to be this
+// far apart in pixelBright() units
+#define CAM_HIST_MIN_SPLIT 88
+#define CAM_HIST_MIN_CONTRAST (CAM_BRIGHT_MAX / 8)
+// The histogram is built when a frame is taken, not while it arrives, on
+// purpose: the DMA capture has no per-row hook and the interrupts only move
+// bytes. So it is a pass of its own, and a sparse one: the line can be
+// anywhere in the band before the threshold lets a kernel find it, so the
+// sample is a lattice over all of it, every CAM_HIST_COL_STEP-th pixel of
+// every CAM_HIST_ROW_STEP-th row: 600 pixels of a full band, a quarter of
+// what every second row cost. A lattice keeps the line's share of the
+// sample what it is in the whole frame, so the Otsu checks above hold.
+#ifndef CAM_HIST_ROW_STEP
+#define CAM_HIST_ROW_STEP 4
+#endif
+#ifndef CAM_HIST_COL_STEP
+#define CAM_HIST_COL_STEP 2
+#endif
+
+typedef struct cameraFrame{
+    uint8_t data[CAM_ROW_BYTES*CAM_BUFFER_ROWS] __attribute__((aligned(4))); // raw RGB565 or Y8, DMA writes words
+    uint32_t id;      // capture sequence number
+    int firstRow;     // image row of data[0]
+    int rows;         // image rows in data
+    uint32_t timestamp; // time_us_32() when the last byte arrived
+    uint32_t bytes;   // bytes actually received
+    uint32_t dropped; // frames dropped between the previous acquireFrame() and this one
+    uint16_t hist[CAM_HIST_BINS]; // brightness histogram of a sample, built when the frame is taken
+    uint32_t histPixels; // pixels counted in hist
+    int threshold;    // pixelBright() of a line pixel is at least this, from hist
+    volatile uint8_t state;
+} cameraFrame_t;
+
+#if CAM_LUMA_ONLY
+// brightness of one Y8 pixel
+static inline int pixelBright(const uint8_t *p){
+    return p[0];
+}
+#else
+// brightness of one packed RGB565 pixel (low byte first), on the same
+// scale as picture.r + picture.g + picture.b from convertImage()
+static inline int pixelBright(const uint8_t *p){
+    return ((p[1]>>3)<<3) + ((((p[1]&0b111)<<3) | p[0]>>5)<<2) + ((p[0]&0b11111)<<3);
+}
+#endif
+
+// SWAR (SIMD within a register) kernels: 4 packed Y8 pixels per 32-bit word,
+// only possible in luma mode. 0 keeps the one pixel at a time kernels.
+#ifndef CAM_SWAR
+#define CAM_SWAR (CAM_LUMA_ONLY && !CAM_DEBUG_RGB)
+#endif
+
+#if CAM_LUMA_ONLY
+#define SWAR_ONES 0x01010101u
+#define SWAR_HIGH 0x80808080u
+
+// 0x80 in every byte lane where a >= b, unsigned, no borrow between lanes
+static inline uint32_t swarGE(uint32_t a, uint32_t b){
+    uint32_t d = (a | SWAR_HIGH) - (b & ~SWAR_HIGH); // low 7 bits compare
+    return ((a & ~b) | (~(a ^ b) & d)) & SWAR_HIGH;
+}
+
+// sum of the 4 byte lanes, and the sum weighted by lane number (byte 0 first)
+static inline void swarMass(uint32_t v, int *mass, int *massI){
+    uint32_t even = v & 0x00FF00FF;       // lanes 0 and 2
+    uint32_t odd = (v >> 8) & 0x00FF00FF; // lanes 1 and 3
+    uint32_t pairs = even + odd;
+    *mass = (pairs & 0xFFFF) + (pairs >> 16);
+    *massI = (odd & 0xFFFF) + 2*(even >> 16) + 3*(odd >> 16);
+}
+#endif
+
+void startFrameStream();
+void stopFrameStream();
+cameraFrame_t *acquireFrame();
+void releaseFrame(cameraFrame_t *f);
+uint32_t getDroppedFrames();
 
 typedef struct cameraImage{
     uint32_t index;
@@ -67,10 +279,10 @@ typedef struct cameraImage{
     uint8_t g[IMAGESIZEX*IMAGESIZEY];
     uint8_t b[IMAGESIZEX*IMAGESIZEY];
 } cameraImage_t;
-static volatile struct cameraImage picture;
 // I2C functions
 void OV7670_write_register(uint8_t reg, uint8_t value);
 uint8_t OV7670_read_register(uint8_t reg);
+void OV7670_write_table(const uint8_t table[][2]);
 void OV7670_test_pattern(OV7670_pattern pattern);
 
 #endif
\ No newline at end of file
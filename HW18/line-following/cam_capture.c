@@ -0,0 +1,82 @@
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+
+#include "cam.h"
+#include "cam_capture.h"
+#include "cam_capture.pio.h"
+
+static PIO cap_pio;
+static uint cap_sm;
+static uint cap_offset;
+static int cap_dma;
+static uint32_t cap_rows;
+static uint32_t cap_bytes;
+
+// the whole frame has been written to memory
+static void __isr cam_capture_dma_handler(){
+    if (dma_hw->ints0 & (1u << cap_dma)){
+        dma_hw->ints0 = 1u << cap_dma;
+        cam_frame_complete(cap_rows, cap_bytes);
+    }
+}
+
+// the state machine saw falling VS and is waiting for the first row
+static void __isr cam_capture_pio_handler(){
+    if (pio_interrupt_get(cap_pio, cap_sm)){
+        pio_interrupt_clear(cap_pio, cap_sm);
+        cam_frame_start();
+    }
+}
+
+void cam_capture_init(void){
+    // luma only drops the chroma bytes in the PIO, so they never reach memory
+    const pio_program_t *program = CAM_LUMA_ONLY ? &cam_capture_luma_program : &cam_capture_program;
+    bool ok = pio_claim_free_sm_and_add_program_for_gpio_range(program, &cap_pio, &cap_sm, &cap_offset, D0, CAM_PIN_PCLK + 1, true);
+    hard_assert(ok);
+    cam_capture_program_init(cap_pio, cap_sm, cap_offset, D0, CAM_LUMA_ONLY);
+
+    cap_dma = dma_claim_unused_channel(true);
+    dma_channel_set_irq0_enabled(cap_dma, true);
+    irq_add_shared_handler(DMA_IRQ_0, cam_capture_dma_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    // "irq nowait 0 rel" in the program raises flag <sm> at the start of a frame
+    uint pio_irq = pio_get_irq_num(cap_pio, 0);
+    pio_set_irqn_source_enabled(cap_pio, 0, pis_interrupt0 + cap_sm, true);
+    irq_add_shared_handler(pio_irq, cam_capture_pio_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(pio_irq, true);
+}
+
+void cam_capture_start(volatile uint8_t *dest, uint32_t rows, uint32_t rowBytes){
+    cap_rows = rows;
+    cap_bytes = rows * rowBytes;
+
+    // the PIO pushes whole words, so rowBytes has to be a multiple of 4
+    dma_channel_config c = dma_channel_get_default_config(cap_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, pio_get_dreq(cap_pio, cap_sm, false));
+    dma_channel_configure(cap_dma, &c, dest, &cap_pio->rxf[cap_sm], cap_bytes / 4, true);
+
+    // the state machine is parked on "pull block" until these arrive
+    pio_sm_put_blocking(cap_pio, cap_sm, rows - 1);
+    pio_sm_put_blocking(cap_pio, cap_sm, rowBytes - 1);
+}
+
+void cam_capture_stop(void){
+    pio_sm_set_enabled(cap_pio, cap_sm, false);
+    // an abort can raise the completion interrupt (RP2040-E13), keep it
+    // from reporting a frame
+    dma_channel_set_irq0_enabled(cap_dma, false);
+    dma_channel_abort(cap_dma);
+    dma_channel_acknowledge_irq0(cap_dma);
+    dma_channel_set_irq0_enabled(cap_dma, true);
+    // back to the "pull block" at the top, with nothing left in the FIFOs
+    pio_sm_clear_fifos(cap_pio, cap_sm);
+    pio_sm_restart(cap_pio, cap_sm);
+    pio_sm_exec(cap_pio, cap_sm, pio_encode_jmp(cap_offset));
+    pio_sm_set_enabled(cap_pio, cap_sm, true);
+}
@@ -0,0 +1,23 @@
+#ifndef CAM_CAPTURE_h
+#define CAM_CAPTURE_h
+
+#include <stdint.h>
+
+// Frame capture engine behind setSaveImage/getSaveImage.
+// On the pico this is a PIO state machine + DMA channel (cam_capture.c),
+// on the host it is host/cam_capture_host.c which replays recorded frames.
+
+// claim the PIO state machine and DMA channel, call after the pins are set up
+void cam_capture_init(void);
+// capture the next frame (rows x rowBytes) into dest, returns immediately
+void cam_capture_start(volatile uint8_t *dest, uint32_t rows, uint32_t rowBytes);
+// drop the capture armed by cam_capture_start(), nothing completes after this
+// and the next start waits for a new frame
+void cam_capture_stop(void);
+
+// implemented in cam.c, called from the start-of-frame (falling VS) interrupt
+void cam_frame_start(void);
+// implemented in cam.c, called once from the end-of-frame interrupt
+void cam_frame_complete(uint32_t rows, uint32_t bytes);
+
+#endif
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#include "cam_stats.h"
+
+volatile camStats_t camStats;
+
+static const char *stageNames[STAT_COUNT] = {
+    "capture", "period", "convert", "detect", "latency", "tick"
+};
+
+// Core 0's capture interrupts and frame loop and core 1's control tick all
+// record, and 'z' resets from core 0. Masking interrupts only keeps out the
+// calling core, so the spin lock keeps out the other one. Until
+// camStatsInit() claims it there is only core 0.
+static spin_lock_t *statsLock = NULL;
+
+static uint32_t statsLockTake(void){
+    return statsLock ? spin_lock_blocking(statsLock) : save_and_disable_interrupts();
+}
+
+static void statsLockGive(uint32_t save){
+    if (statsLock){
+        spin_unlock(statsLock, save);
+    } else {
+        restore_interrupts(save);
+    }
+}
+
+void camStatsInit(void){
+    if (statsLock == NULL){
+        statsLock = spin_lock_init(spin_lock_claim_unused(true));
+    }
+}
+
+void camStatsReset(void){
+    uint32_t save = statsLockTake();
+    camStats.framesCaptured = 0;
+    camStats.framesDropped = 0;
+    camStats.framesShort = 0;
+    camStats.lastRows = 0;
+    camStats.lastBytes = 0;
+    camStats.busyUs[0] = 0;
+    camStats.busyUs[1] = 0;
+    camStats.busySince = time_us_32();
+    int s, k;
+    for(s=0;s<STAT_COUNT;s++){
+        volatile statHist_t *h = &camStats.stage[s];
+        h->count = 0;
+        h->min = 0;
+        h->max = 0;
+        h->sum = 0;
+        for(k=0;k<STAT_BINS;k++){
+            h->bins[k] = 0;
+        }
+    }
+    statsLockGive(save);
+}
+
+// add one sample, safe to call from the capture interrupts and either core
+void camStatsRecord(int stage, uint32_t us){
+    volatile statHist_t *h = &camStats.stage[stage];
+    int bin = (us == 0) ? 0 : 32 - __builtin_clz(us);
+    if (bin >= STAT_BINS) bin = STAT_BINS - 1;
+
+    uint32_t save = statsLockTake();
+    if (h->count == 0 || us < h->min) h->min = us;
+    h->count++;
+    h->sum += us;
+    if (us > h->max) h->max = us;
+    h->bins[bin]++;
+    statsLockGive(save);
+}
+
+// each core only adds to its own count, but a reset from the other core
+// clears it
+void camStatsBusy(uint32_t us){
+    uint32_t save = statsLockTake();
+    camStats.busyUs[get_core_num()] += us;
+    statsLockGive(save);
+}
+
+// one line per counter / stage, ends with "stats end"
+//   stats frames <captured> dropped <n> short <n> rows <n> bytes <n>
+//   stats boot init <us> first <us>
+//   stats cores <us> busy <core 0 %> <core 1 %>
+//   stats <stage> <count> <min> <avg> <max> <bin0> ... <bin19>
+void camStatsPrint(void){
+    printf("stats frames %lu dropped %lu short %lu rows %lu bytes %lu\r\n",
+        (unsigned long)camStats.framesCaptured, (unsigned long)camStats.framesDropped,
+        (unsigned long)camStats.framesShort, (unsigned long)camStats.lastRows,
+        (unsigned long)camStats.lastBytes);
+    printf("stats boot init %lu first %lu\r\n",
+        (unsigned long)camStats.initUs, (unsigned long)camStats.firstFrameUs);
+    uint32_t window = time_us_32() - camStats.busySince;
+    printf("stats cores %lu busy %lu %lu\r\n", (unsigned long)window,
+        (unsigned long)(window ? camStats.busyUs[0] * 100 / window : 0),
+        (unsigned long)(window ? camStats.busyUs[1] * 100 / window : 0));
+    int s, k;
+    for(s=0;s<STAT_COUNT;s++){
+        volatile statHist_t *h = &camStats.stage[s];
+        uint32_t count = h->count;
+        uint32_t avg = count ? (uint32_t)(h->sum / count) : 0;
+        printf("stats %s %lu %lu %lu %lu", stageNames[s], (unsigned long)count,
+            (unsigned long)h->min, (unsigned long)avg, (unsigned long)h->max);
+        for(k=0;k<STAT_BINS;k++){
+            printf(" %lu", (unsigned long)h->bins[k]);
+        }
+        printf("\r\n");
+    }
+    printf("stats end\r\n");
+}
+
+int camStatsCommand(int c){
+    if (c == 's'){
+        camStatsPrint();
+        return 1;
+    }
+    if (c == 'z'){
+        camStatsReset();
+        return 1;
+    }
+    return 0;
+}
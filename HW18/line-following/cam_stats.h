@@ -0,0 +1,58 @@
+#ifndef CAM_STATS_h
+#define CAM_STATS_h
+
+#include <stdint.h>
+
+// Camera pipeline counters and timings, filled in by cam.c and the main loop.
+// 's' over USB prints them, 'z' zeroes them (python/read_camera.py reads them).
+
+// timed stages, all in us
+enum {
+    STAT_CAPTURE = 0, // falling VS to the last byte of the frame in memory
+    STAT_PERIOD,      // frame complete to the next frame complete
+    STAT_CONVERT,     // convertImage() or any other per-frame decode
+    STAT_DETECT,      // finding the line in the frame
+    STAT_LATENCY,     // frame complete to the line estimate being used
+    STAT_TICK,        // control tick to the next one, CONTROL_PERIOD_US when on time
+    STAT_COUNT
+};
+
+// histogram bin k counts values in [2^(k-1), 2^k) us, bin 0 is 0 us
+#define STAT_BINS 20
+
+typedef struct statHist{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t bins[STAT_BINS];
+} statHist_t;
+
+typedef struct camStats{
+    uint32_t framesCaptured;
+    uint32_t framesDropped; // complete frames overwritten before anyone took them
+    uint32_t framesShort;   // frames with fewer bytes than the window asked for
+    uint32_t lastRows;      // rows and bytes of the last frame captured
+    uint32_t lastBytes;
+    uint32_t initUs;       // init_camera_pins() from start to end, kept by 'z'
+    uint32_t firstFrameUs; // boot to the first frame complete, kept by 'z'
+    uint64_t busyUs[2];    // per core, time spent working rather than waiting
+    uint32_t busySince;    // time_us_32() busyUs counts from
+    statHist_t stage[STAT_COUNT];
+} camStats_t;
+
+extern volatile camStats_t camStats;
+
+// claims the spin lock that keeps the two cores' updates apart, call
+// before core 1 starts
+void camStatsInit(void);
+void camStatsReset(void);
+void camStatsRecord(int stage, uint32_t us);
+// us of work on the calling core: the frame loop on core 0, the control
+// ticks and telemetry on core 1
+void camStatsBusy(uint32_t us);
+void camStatsPrint(void);
+// handles 's' and 'z', returns 1 if the byte was one of them
+int camStatsCommand(int c);
+
+#endif
@@ -20,10 +20,14 @@ int main()
 
         setSaveImage(1);
         while(getSaveImage()==1){}
+#if CAM_DEBUG_RGB
         convertImage();
+#endif
         int com = findLine(IMAGESIZEY/2); // calculate the position of the center of the ine
+#if CAM_DEBUG_RGB
         setPixel(IMAGESIZEY/2,com,0,255,0); // draw the center so you can see it in python
         //printImage();
+#endif
         printf("%d\r\n",com); // comment this when testing with python
     }
 }
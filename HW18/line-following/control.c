@@ -0,0 +1,148 @@
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#include "control.h"
+#include "mailbox.h"
+#include "ground.h"
+#include "cam_stats.h"
+#include "motor_control.h"
+
+// the frame loop's core posts into posted, the ticks copy it into estimate
+static mailbox_t estimateBox;
+static visionEstimate_t posted;
+static visionEstimate_t estimate;
+static controlStatus_t status;
+static alarm_pool_t *pool = NULL;
+static struct repeating_timer timer;
+static uint32_t lastTick = 0;
+
+void controlReset(void){
+    mailboxReset(&estimateBox);
+    trackReset(&estimate.track);
+    estimate.slope = 0;
+    estimate.topology = 0;
+    estimate.seq = 0;
+    uint32_t save = save_and_disable_interrupts();
+    status = (controlStatus_t){0};
+    restore_interrupts(save);
+}
+
+void controlPublish(const lineTrack_t *t, real_t slope, int topology){
+    visionEstimate_t e;
+    e.track = *t;
+    e.slope = slope;
+    e.topology = topology;
+    e.seq = 0;
+    mailboxPost(&estimateBox, &posted, &e, sizeof(e));
+}
+
+static int clampSpeed(int speed){
+    if (speed > CONTROL_MAX_SPEED) return CONTROL_MAX_SPEED;
+    if (speed < CONTROL_MIN_SPEED) return CONTROL_MIN_SPEED;
+    return speed;
+}
+
+void controlStep(uint32_t now, int *left, int *right){
+    // a copy that overlapped a post is dropped, the last one still holds
+    visionEstimate_t e;
+    uint32_t seq = mailboxTake(&estimateBox, &posted, &e, sizeof(e));
+    if (seq != 0){
+        estimate = e;
+        estimate.seq = seq;
+    }
+    const lineTrack_t *t = &estimate.track;
+    int mid = IMAGESIZEX / 2;
+
+    // slow down while the track is coasting
+    real_t confidence = trackConfidence(t, now);
+    int base = CONTROL_MIN_SPEED + REAL_TO_INT(REAL_MUL(confidence, REAL_FROM_INT(CONTROL_BASE_SPEED - CONTROL_MIN_SPEED)));
+
+    status.ticks++;
+    status.seq = estimate.seq;
+    status.confidence = confidence;
+    status.slope = estimate.slope;
+    status.topology = estimate.topology;
+    if (!t->valid){
+        // lost, go straight slowly and start the integral over
+        status.error = 0;
+        status.integral = 0;
+        *left = base;
+        *right = base;
+        status.left = base;
+        status.right = base;
+        return;
+    }
+
+    // where the line is now, not when the frame was taken
+    real_t error = groundSide(trackPredict(t, now), mid) - groundSide(REAL_FROM_INT(CONTROL_TARGET_ROW), mid);
+    real_t feedForward = REAL_MUL(CONTROL_HEADING_GAIN, estimate.slope);
+    status.error = error;
+
+    // inside the deadband only the integral trims, e.g. for a camera that
+    // isn't quite straight
+    real_t pd = 0;
+    real_t integral = status.integral;
+    if (REAL_ABS(error) >= CONTROL_DEADBAND || REAL_ABS(feedForward) >= CONTROL_FF_DEADBAND){
+        // derivative on the measurement: the tracker's rate is how fast the
+        // line moves across, so a new frame's correction doesn't kick the output
+        real_t rate = REAL_MUL(t->rate, groundMmPerRow(mid));
+        pd = REAL_MUL(CONTROL_KP, error) + REAL_MUL(CONTROL_KD, rate) + feedForward;
+        integral = integral + REAL_SCALE(REAL_MUL(CONTROL_KI, error), CONTROL_PERIOD_US, 1000000);
+        if (integral > CONTROL_I_MAX) integral = CONTROL_I_MAX;
+        if (integral < -CONTROL_I_MAX) integral = -CONTROL_I_MAX;
+    }
+    int adjust = REAL_TO_INT(pd + integral);
+    int l = base + adjust;
+    int r = base - adjust;
+    // anti-windup: with both wheels at their limits the output can't do
+    // more, don't grow the integral any further that way
+    int saturated = l != clampSpeed(l) && r != clampSpeed(r);
+    if (saturated && integral != status.integral && (adjust > 0) == (integral > status.integral)){
+        integral = status.integral;
+        adjust = REAL_TO_INT(pd + integral);
+        l = base + adjust;
+        r = base - adjust;
+    }
+    status.integral = integral;
+
+    *left = clampSpeed(l);
+    *right = clampSpeed(r);
+    status.left = *left;
+    status.right = *right;
+}
+
+static bool controlTick(struct repeating_timer *rt){
+    (void)rt;
+    uint32_t now = time_us_32();
+    if (lastTick != 0){
+        camStatsRecord(STAT_TICK, now - lastTick);
+    }
+    uint32_t dt = lastTick != 0 ? now - lastTick : CONTROL_PERIOD_US;
+    lastTick = now;
+    int left, right;
+    controlStep(now, &left, &right);
+    motor_speed_set(left, right);
+    motor_speed_update(dt);
+    camStatsBusy(time_us_32() - now);
+    return true; // keep ticking
+}
+
+bool controlStart(void){
+    lastTick = 0;
+    // the default pool's alarms fire on core 0, one made here fires here
+    if (pool == NULL){
+        pool = alarm_pool_create_with_unused_hardware_alarm(1);
+    }
+    // a negative period is start to start, so the rate doesn't drift with the tick's own time
+    return alarm_pool_add_repeating_timer_us(pool, -CONTROL_PERIOD_US, controlTick, NULL, &timer);
+}
+
+void controlStop(void){
+    cancel_repeating_timer(&timer);
+}
+
+void controlGetStatus(controlStatus_t *s){
+    uint32_t save = save_and_disable_interrupts();
+    *s = status;
+    restore_interrupts(save);
+}
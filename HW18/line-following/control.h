@@ -0,0 +1,74 @@
+#ifndef CONTROL_h
+#define CONTROL_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tracker.h"
+
+// Steering on a hardware repeating_timer at CONTROL_HZ, apart from the frame
+// loop. The frame loop publishes the tracker after every frame, each tick
+// predicts the line to the tick time and runs a PID on the lateral error in
+// mm (ground.h), with the line's floor slope as feed forward. Frame jitter,
+// dropped frames and printf no longer change when the motors get a duty.
+// The frame loop runs on core 0 and the ticks on core 1, the estimate goes
+// across in a mailbox (mailbox.h) so neither core waits for the other.
+
+#ifndef CONTROL_HZ
+#define CONTROL_HZ 200
+#endif
+#define CONTROL_PERIOD_US (1000000 / CONTROL_HZ)
+
+// wheel speeds in mm/s, motor_control.c holds each wheel at its speed
+#define CONTROL_MAX_SPEED 300  // what a flat battery still makes
+#define CONTROL_MIN_SPEED 150  // no wheel slower while steering
+#define CONTROL_BASE_SPEED 175 // straight ahead on a sure track
+#define CONTROL_TARGET_ROW (IMAGESIZEX / 2) // image row the line is held on
+
+// PID on the error in mm, out in mm/s of speed difference. On the original
+// mount 1 image row is GROUND_MM_PER_ROW_MID (1.64) mm across.
+#define CONTROL_KP REAL(2.75)         // mm/s per mm, was 0.55 duty per mm
+#define CONTROL_KI REAL(1.5)          // mm/s per mm second
+#define CONTROL_KD REAL(0.1)          // mm/s per mm/s the line moves across
+#define CONTROL_I_MAX REAL(50.0)      // mm/s, most the integral can add
+#define CONTROL_HEADING_GAIN REAL(170.0) // mm/s per mm across per mm ahead
+#define CONTROL_DEADBAND REAL(8.0)    // mm
+#define CONTROL_FF_DEADBAND REAL(40.0) // mm/s of heading feed forward
+
+// the frame loop's side of the controller
+typedef struct visionEstimate{
+    lineTrack_t track;  // tracker after the frame
+    real_t slope;       // floor slope of the line, 0 unless the fit was clean
+    int topology;       // TOPO_* of the last full scan, for the telemetry
+    uint32_t seq;       // counts published estimates, filled in by the reader
+} visionEstimate_t;
+
+// what the last tick did
+typedef struct controlStatus{
+    real_t error;       // mm
+    real_t slope;
+    real_t confidence;
+    real_t integral;    // duty
+    int left;           // wheel speeds asked for, mm/s
+    int right;
+    uint32_t ticks;
+    uint32_t seq;       // estimate the tick used
+    int topology;       // and its topology
+} controlStatus_t;
+
+// before the ticks start
+void controlReset(void);
+// hand the tracker to the controller, the frame loop calls this after every
+// frame, from the other core than the ticks
+void controlPublish(const lineTrack_t *t, real_t slope, int topology);
+// one control tick at time now, left and right wheel speeds out.
+// The timer runs it, host programs call it directly.
+void controlStep(uint32_t now, int *left, int *right);
+// start and stop the timer, motor_init() and motor_speed_init() first. The
+// ticks run on the core that calls controlStart(), each one also runs the
+// wheel speed loop.
+bool controlStart(void);
+void controlStop(void);
+// what the last tick did, on the core the ticks run on
+void controlGetStatus(controlStatus_t *s);
+
+#endif
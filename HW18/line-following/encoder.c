@@ -0,0 +1,56 @@
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+
+#include "cam.h"
+#include "motor_control.h"
+#include "encoder.h"
+#include "encoder.pio.h"
+
+// the pin or the one after it is one of the camera's or the motors'
+#define ENCODER_PIN_TAKEN(p) ((p) + 1 >= D0 && (p) <= D0 + 7) \
+    || ENCODER_PIN_IS(p, VS) || ENCODER_PIN_IS(p, HS) || ENCODER_PIN_IS(p, MCLK) || ENCODER_PIN_IS(p, PCLK) \
+    || ENCODER_PIN_IS(p, RST) || ENCODER_PIN_IS(p, PWDN) || ENCODER_PIN_IS(p, I2C_SDA) || ENCODER_PIN_IS(p, I2C_SCL) \
+    || ENCODER_PIN_IS(p, AIN1) || ENCODER_PIN_IS(p, AIN2) || ENCODER_PIN_IS(p, BIN1) || ENCODER_PIN_IS(p, BIN2) \
+    || ENCODER_PIN_IS(p, LED_LEFT) || ENCODER_PIN_IS(p, LED_RIGHT)
+#define ENCODER_PIN_IS(p, pin) ((p) == (pin) || (p) + 1 == (pin))
+
+#if ENCODER_PIN_TAKEN(ENCODER_LEFT_PIN)
+#error "the left encoder shares a pin with the camera or the motors"
+#endif
+#if ENCODER_PIN_TAKEN(ENCODER_RIGHT_PIN)
+#error "the right encoder shares a pin with the camera or the motors"
+#endif
+#if ENCODER_LEFT_PIN + 1 == ENCODER_RIGHT_PIN || ENCODER_RIGHT_PIN + 1 == ENCODER_LEFT_PIN || ENCODER_LEFT_PIN == ENCODER_RIGHT_PIN
+#error "the encoders share a pin"
+#endif
+
+static PIO enc_pio;
+static uint enc_sm[2];
+
+void encoder_init(void){
+    // the program has to sit at 0, in a PIO of its own next to the camera's,
+    // and that PIO has to reach both wheels' pins
+    uint offset;
+    uint first = ENCODER_LEFT_PIN < ENCODER_RIGHT_PIN ? ENCODER_LEFT_PIN : ENCODER_RIGHT_PIN;
+    uint last = ENCODER_LEFT_PIN < ENCODER_RIGHT_PIN ? ENCODER_RIGHT_PIN : ENCODER_LEFT_PIN;
+    bool ok = pio_claim_free_sm_and_add_program_for_gpio_range(&encoder_program, &enc_pio, &enc_sm[ENCODER_LEFT], &offset, first, last + 2 - first, true);
+    hard_assert(ok && offset == 0);
+    // the right wheel runs the same program
+    enc_sm[ENCODER_RIGHT] = pio_claim_unused_sm(enc_pio, true);
+    encoder_program_init(enc_pio, enc_sm[ENCODER_LEFT], ENCODER_LEFT_PIN);
+    encoder_program_init(enc_pio, enc_sm[ENCODER_RIGHT], ENCODER_RIGHT_PIN);
+}
+
+int32_t encoder_count(int wheel){
+    PIO pio = enc_pio;
+    uint sm = enc_sm[wheel];
+    // the state machine pushes the count every loop and drops pushes while
+    // the FIFO is full: drain what is there, the one after is current
+    uint n = pio_sm_get_rx_fifo_level(pio, sm) + 1;
+    uint32_t count = 0;
+    while (n > 0){
+        count = pio_sm_get_blocking(pio, sm);
+        n--;
+    }
+    return (int32_t)count;
+}
@@ -0,0 +1,29 @@
+#ifndef ENCODER_h
+#define ENCODER_h
+
+#include <stdint.h>
+
+// Wheel encoder counts. On the pico a PIO state machine per wheel counts
+// every edge of A and B (encoder.pio), on the host host/motor_sim.c
+// takes the counts from a simulated motor.
+
+#define ENCODER_LEFT 0   // on motor A
+#define ENCODER_RIGHT 1  // on motor B
+
+// A on the pin, B on the next one. GP0-GP15 are the camera's, the
+// motors and LEDs are in motor_control.h; encoder.c refuses to build if
+// they meet.
+#ifndef ENCODER_LEFT_PIN
+#define ENCODER_LEFT_PIN 20
+#endif
+#ifndef ENCODER_RIGHT_PIN
+#define ENCODER_RIGHT_PIN 26
+#endif
+
+// claim a PIO state machine for each wheel
+void encoder_init(void);
+// edges counted since encoder_init(), as the PIO counts them: the sign
+// depends on how the encoder is mounted, see ENCODER_*_DIR
+int32_t encoder_count(int wheel);
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef FIXED_POINT_h
+#define FIXED_POINT_h
+
+#include <stdint.h>
+#include <math.h>
+#include "pico/stdlib.h"
+
+// Number type for the per-frame vision and control math.
+// RP2040 (Cortex-M0+) has no FPU, every float op there is a soft-float call,
+// so it gets Q16.16 fixed point. RP2350 keeps float on its FPU.
+// Build with -DCAM_FIXED_POINT=0/1 to pick one either way.
+#ifndef CAM_FIXED_POINT
+#if defined(PICO_RP2040) && PICO_RP2040
+#define CAM_FIXED_POINT 1
+#else
+#define CAM_FIXED_POINT 0
+#endif
+#endif
+
+#if CAM_FIXED_POINT
+
+typedef int32_t real_t; // Q16.16
+
+#define REAL_ONE 65536
+// constants only, the double math is folded by the compiler
+#define REAL(x) ((real_t)((x) * 65536.0 + ((x) < 0 ? -0.5 : 0.5)))
+#define REAL_FROM_INT(i) ((real_t)(i) * REAL_ONE)
+// n / d without going through float
+#define REAL_FRAC(n, d) ((real_t)(((int64_t)(n) * REAL_ONE) / (d)))
+#define REAL_MUL(a, b) ((real_t)(((int64_t)(a) * (b)) >> 16))
+// a * n / d for integer n and d, e.g. a rate times us / 1000000
+#define REAL_SCALE(a, n, d) ((real_t)((int64_t)(a) * (n) / (d)))
+#define REAL_DIV(a, b) ((real_t)(((int64_t)(a) * REAL_ONE) / (b)))
+#define REAL_ABS(a) ((a) < 0 ? -(a) : (a))
+// towards zero, like (int) on a float
+#define REAL_TO_INT(a) ((a) < 0 ? -(-(a) >> 16) : (a) >> 16)
+#define REAL_TO_FLOAT(a) ((float)(a) / REAL_ONE)
+// to a Q15 fraction, e.g. a PWM duty
+#define REAL_TO_Q15(a) ((int32_t)(a) >> 1)
+#define REAL_ATAN(a) q16Atan(a)
+
+// atan(x) = pi/4 x + 0.273 x (1 - |x|) for |x| <= 1, atan(x) = pi/2 - atan(1/x)
+// above that, within 0.004 rad
+static inline real_t q16Atan(real_t x){
+    int neg = x < 0;
+    if (neg) x = -x;
+    int inv = x > REAL_ONE;
+    if (inv) x = (real_t)(((int64_t)REAL_ONE << 16) / x);
+    real_t a = REAL_MUL(REAL(0.78539816), x) + REAL_MUL(REAL_MUL(REAL(0.273), x), REAL_ONE - x);
+    if (inv) a = REAL(1.57079633) - a;
+    return neg ? -a : a;
+}
+
+#else
+
+typedef float real_t;
+
+#define REAL_ONE 1.0f
+#define REAL(x) ((real_t)(x))
+#define REAL_FROM_INT(i) ((real_t)(i))
+#define REAL_FRAC(n, d) ((real_t)(n) / (real_t)(d))
+#define REAL_MUL(a, b) ((a) * (b))
+#define REAL_SCALE(a, n, d) ((a) * (real_t)(n) / (real_t)(d))
+#define REAL_DIV(a, b) ((a) / (b))
+#define REAL_ABS(a) fabsf(a)
+#define REAL_TO_INT(a) ((int)(a))
+#define REAL_TO_FLOAT(a) (a)
+#define REAL_TO_Q15(a) ((int32_t)((a) * 32768.0f))
+#define REAL_ATAN(a) atanf(a)
+
+#endif
+
+#endif
@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "frame_stream.h"
+
+// CRC-32 (same as python zlib.crc32), a nibble at a time to keep the table small
+static const uint32_t crcTable[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+// start with crc = 0, feed the result back in for the next block
+uint32_t crc32Update(uint32_t crc, const uint8_t *data, uint32_t len){
+    crc = ~crc;
+    uint32_t i;
+    for(i=0;i<len;i++){
+        crc = crcTable[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = crcTable[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+// raw bytes, no \n -> \r\n translation
+static void sendBytes(const void *data, uint32_t len){
+    stdio_put_string((const char *)data, (int)len, false, false);
+}
+
+// worst case for the delta coder: changed and unchanged bytes taking turns,
+// every changed byte costs a (1 zero, 1 literal, literal) group, 3 bytes
+// for 2, plus a group with no zeros at the start. The binary RLE stays
+// under one byte per pixel.
+#define FRAME_ENCODE_MAX (3*(CAM_ROW_BYTES*CAM_BUFFER_ROWS)/2 + 3)
+static uint8_t encodeBuffer[FRAME_ENCODE_MAX];
+
+// last frame sent with FRAME_ENC_DELTA_RLE, what the computer has on screen
+static uint8_t lastSent[CAM_ROW_BYTES*CAM_BUFFER_ROWS];
+static int lastSentFirstRow = -1;
+static int lastSentRows = -1;
+static int framesSinceKey = FRAME_KEY_INTERVAL;
+
+static int streamEncoding = FRAME_ENC_RAW;
+static int streamVideo = 0;
+static int streamOne = 0;
+
+// Threshold at the frame's line threshold, the one the line finders use,
+// and code the bits as alternating black/white run lengths.
+// Runs over 255 are split with a 0 run.
+static uint32_t encodeBinaryRLE(const cameraFrame_t *f, uint8_t *out){
+    uint32_t n = 0;
+    uint8_t color = 0; // runs start with black
+    uint32_t run = 0;
+    int row, i;
+#if CAM_SWAR
+    int words = f->threshold <= CAM_BRIGHT_MAX;
+    uint32_t t4 = (uint32_t)f->threshold * SWAR_ONES;
+#endif
+    for(row=0;row<f->rows;row++){
+        const uint8_t *p = f->data + row*CAM_ROW_BYTES;
+        for(i=0;i<IMAGESIZEX;i++){
+#if CAM_SWAR
+            // 4 pixels that all continue the current run go in one step
+            if (words && (i & 3) == 0 && i + 4 <= IMAGESIZEX && run + 4 <= 255){
+                uint32_t x;
+                memcpy(&x, p + i, 4);
+                if (swarGE(x, t4) == (color ? SWAR_HIGH : 0)){
+                    run = run + 4;
+                    i = i + 3;
+                    continue;
+                }
+            }
+#endif
+            uint8_t bit = pixelBright(p + i*CAM_BYTES_PER_PIXEL) >= f->threshold;
+            if (bit != color){
+                out[n++] = run;
+                color = bit;
+                run = 0;
+            } else if (run == 255){
+                out[n++] = 255;
+                out[n++] = 0; // empty run of the other color
+                run = 0;
+            }
+            run++;
+        }
+    }
+    out[n++] = run;
+    return n;
+}
+
+// XOR against the previous frame sent, code as (zero run, literal count, literals)
+static uint32_t encodeDeltaRLE(const uint8_t *data, uint32_t len, uint8_t *prev, uint8_t *out){
+    uint32_t n = 0;
+    uint32_t i = 0;
+    while (i < len){
+        uint32_t zeros = 0;
+        while (i < len && zeros < 255 && (data[i] ^ prev[i]) == 0){
+            zeros++;
+            i++;
+        }
+        out[n++] = zeros;
+        uint32_t countAt = n++;
+        uint32_t literals = 0;
+        while (i < len && literals < 255 && (data[i] ^ prev[i]) != 0){
+            out[n++] = data[i] ^ prev[i];
+            prev[i] = data[i];
+            literals++;
+            i++;
+        }
+        out[countAt] = literals;
+    }
+    return n;
+}
+
+static void sendPacket(frameHeader_t *h, const uint8_t *payload){
+    uint32_t crc = crc32Update(0, (const uint8_t *)h, sizeof(*h));
+    crc = crc32Update(crc, payload, h->payloadBytes);
+
+    sendBytes(h, sizeof(*h));
+    sendBytes(payload, h->payloadBytes);
+    sendBytes(&crc, sizeof(crc));
+    stdio_flush();
+}
+
+void sendFrameEncoded(const cameraFrame_t *f, int encoding){
+    frameHeader_t h;
+    h.magic = FRAME_MAGIC;
+    h.id = f->id;
+    h.timestamp = f->timestamp;
+    h.width = IMAGESIZEX;
+    h.height = f->rows;
+    h.format = CAM_LUMA_ONLY ? FRAME_FORMAT_Y8 : FRAME_FORMAT_RGB565;
+    h.firstRow = f->firstRow;
+    h.flags = encoding;
+
+    uint32_t len = f->rows * CAM_ROW_BYTES;
+    const uint8_t *payload = f->data;
+
+    if (encoding == FRAME_ENC_BINARY_RLE){
+        h.format = FRAME_FORMAT_BINARY;
+        payload = encodeBuffer;
+        len = encodeBinaryRLE(f, encodeBuffer);
+    } else if (encoding == FRAME_ENC_DELTA_RLE){
+        if (framesSinceKey >= FRAME_KEY_INTERVAL || f->firstRow != lastSentFirstRow || f->rows != lastSentRows){
+            // start over from black so the computer can join in here
+            uint32_t i;
+            for(i=0;i<len;i++){
+                lastSent[i] = 0;
+            }
+            lastSentFirstRow = f->firstRow;
+            lastSentRows = f->rows;
+            framesSinceKey = 0;
+            h.flags |= FRAME_FLAG_KEY;
+        }
+        framesSinceKey++;
+        payload = encodeBuffer;
+        len = encodeDeltaRLE(f->data, len, lastSent, encodeBuffer);
+    } else {
+        h.flags = FRAME_ENC_RAW;
+    }
+    h.payloadBytes = len;
+    sendPacket(&h, payload);
+}
+
+void sendFrame(const cameraFrame_t *f){
+    sendFrameEncoded(f, FRAME_ENC_RAW);
+}
+
+int streamCommand(int c){
+    switch (c){
+        case 'c':
+            streamOne = 1;
+            break;
+        case 'v':
+            streamVideo = !streamVideo;
+            break;
+        case 'r':
+            streamEncoding = FRAME_ENC_RAW;
+            break;
+        case 'b':
+            streamEncoding = FRAME_ENC_BINARY_RLE;
+            break;
+        case 'd':
+            streamEncoding = FRAME_ENC_DELTA_RLE;
+            framesSinceKey = FRAME_KEY_INTERVAL;
+            break;
+        case 'k':
+            framesSinceKey = FRAME_KEY_INTERVAL;
+            break;
+        default:
+            return 0;
+    }
+    return 1;
+}
+
+void streamFrame(const cameraFrame_t *f){
+    if (streamVideo || streamOne){
+        streamOne = 0;
+        sendFrameEncoded(f, streamEncoding);
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef FRAME_STREAM_h
+#define FRAME_STREAM_h
+
+#include <stdint.h>
+#include "cam.h"
+
+// Binary frame packet sent to the computer, replaces printImage()'s text lines.
+// Little endian: header, payload, then CRC-32 (zlib) of header + payload.
+// python/frame_protocol.py reads these.
+#define FRAME_MAGIC 0x464D4143 // "CAMF"
+
+#define FRAME_FORMAT_RGB565 0
+#define FRAME_FORMAT_Y8 1
+#define FRAME_FORMAT_BINARY 2 // 1 bit per pixel, thresholded like the line finders do
+
+// low byte of flags: how the payload is coded
+#define FRAME_ENC_RAW 0
+// FRAME_FORMAT_BINARY only: run lengths (0-255) alternating black, white, black, ...
+#define FRAME_ENC_BINARY_RLE 1
+// raw bytes XOR the previous frame sent, as (zero run, n literals, literal bytes...)
+#define FRAME_ENC_DELTA_RLE 2
+// flags bit: delta against an all zero frame, decoder can start here
+#define FRAME_FLAG_KEY 0x0100
+
+// a delta key frame at least this often, so a lost packet heals itself
+#define FRAME_KEY_INTERVAL 30
+
+typedef struct __attribute__((packed)) frameHeader{
+    uint32_t magic;
+    uint32_t id;           // cameraFrame_t id
+    uint32_t timestamp;    // us since boot when the frame finished capturing
+    uint16_t width;
+    uint16_t height;       // rows in the payload
+    uint8_t format;        // FRAME_FORMAT_*
+    uint8_t firstRow;      // image row of the first payload row
+    uint16_t flags;        // FRAME_ENC_* | FRAME_FLAG_*
+    uint32_t payloadBytes;
+} frameHeader_t;
+
+uint32_t crc32Update(uint32_t crc, const uint8_t *data, uint32_t len);
+
+// send a complete frame over stdio (USB)
+void sendFrame(const cameraFrame_t *f);
+// same, coded with FRAME_ENC_*
+void sendFrameEncoded(const cameraFrame_t *f, int encoding);
+
+// Commands from the computer:
+//   c  send the next frame       v  video on/off, send every frame
+//   r  raw   b  binary RLE   d  XOR delta RLE   k  next delta is a key frame
+// returns 1 if the byte was one of these
+int streamCommand(int c);
+// call once per analysed frame, sends it if asked for
+void streamFrame(const cameraFrame_t *f);
+
+#endif
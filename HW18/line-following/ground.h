@@ -0,0 +1,45 @@
+#ifndef GROUND_h
+#define GROUND_h
+
+#include "cam.h"
+#include "ground_lut.h"
+
+// Floor positions of image positions from the generated ground_lut.h,
+// so the controller works in mm and its gains carry over to another mount.
+// ahead: mm in front of the lens, side: mm across, + towards higher image rows.
+// No trig at run time, regenerate the table when the camera moves.
+
+static inline real_t groundAhead(int col){
+    return REAL_FRAC(groundAheadLut[col], 16);
+}
+
+// mm across one image row spans on col, also turns rows/s into mm/s
+static inline real_t groundMmPerRow(int col){
+    return REAL_FRAC(groundMmPerRowLut[col], 256);
+}
+
+// row can be between pixels, e.g. a fit offset
+static inline real_t groundSide(real_t row, int col){
+    return REAL_MUL(row - REAL(GROUND_CENTER_ROW), groundMmPerRow(col));
+}
+
+typedef struct groundLine{
+    real_t side;  // mm across where the line crosses the center column
+    real_t ahead; // mm ahead of that point
+    real_t slope; // mm across per mm ahead
+} groundLine_t;
+
+// a lineFit_t from the image on the floor, the slope between the first and
+// the last fitLine() column
+static inline void groundFromFit(const lineFit_t *fit, groundLine_t *g){
+    int mid = IMAGESIZEX / 2;
+    int c1 = CAM_FIT_COLUMN(0);
+    int c2 = CAM_FIT_COLUMN(CAM_FIT_LINES - 1);
+    real_t s1 = groundSide(fit->offset + fit->slope*(c1 - mid), c1);
+    real_t s2 = groundSide(fit->offset + fit->slope*(c2 - mid), c2);
+    g->side = groundSide(fit->offset, mid);
+    g->ahead = groundAhead(mid);
+    g->slope = REAL_DIV(s2 - s1, groundAhead(c2) - groundAhead(c1));
+}
+
+#endif
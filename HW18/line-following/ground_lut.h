@@ -0,0 +1,36 @@
+#ifndef GROUND_LUT_h
+#define GROUND_LUT_h
+
+#include <stdint.h>
+
+// Generated by python/gen_ground_lut.py, do not edit.
+// height 80 mm, tilt 35 deg, fov 50 deg
+
+#define GROUND_CENTER_ROW 29.5 // image row straight ahead of the camera
+#define GROUND_MM_PER_ROW_MID 1.640 // at column 40
+
+// mm ahead of the lens of each image column, in 1/16 mm
+static const uint16_t groundAheadLut[80] = {
+    747, 764, 781, 798, 816, 834, 853, 872, 891, 911,
+    931, 951, 972, 994, 1016, 1039, 1062, 1086, 1110, 1135,
+    1160, 1187, 1213, 1241, 1269, 1298, 1328, 1359, 1390, 1423,
+    1456, 1490, 1526, 1562, 1599, 1638, 1678, 1719, 1762, 1806,
+    1851, 1898, 1946, 1997, 2049, 2103, 2159, 2217, 2277, 2340,
+    2405, 2473, 2544, 2618, 2695, 2776, 2860, 2948, 3041, 3138,
+    3240, 3347, 3460, 3579, 3705, 3838, 3979, 4129, 4288, 4457,
+    4639, 4832, 5040, 5264, 5505, 5765, 6048, 6356, 6692, 7061,
+};
+
+// mm sideways per image row on each image column, in 1/256 mm
+static const uint16_t groundMmPerRowLut[80] = {
+    251, 254, 256, 259, 262, 264, 267, 270, 273, 276,
+    279, 282, 286, 289, 292, 296, 299, 303, 307, 310,
+    314, 318, 322, 327, 331, 335, 340, 345, 349, 354,
+    359, 365, 370, 376, 381, 387, 393, 400, 406, 413,
+    420, 427, 434, 442, 450, 458, 467, 476, 485, 494,
+    504, 515, 526, 537, 549, 561, 574, 587, 602, 616,
+    632, 648, 666, 684, 703, 723, 745, 768, 792, 818,
+    846, 875, 907, 941, 978, 1018, 1061, 1108, 1159, 1216,
+};
+
+#endif
@@ -0,0 +1,57 @@
+// Runs the vision_bench.c kernels on recorded frames, the same numbers the
+// robot prints for 'x' but in ns and averaged over every frame of a file.
+// usage: cam_bench [-r repeats per frame] frames.raw ...
+// One block of "bench <file> ..." lines per file, see vision_bench.h.
+// make_corpus writes a corpus to run it on.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cam.h"
+#include "cam_capture_host.h"
+#include "vision_bench.h"
+
+static visionBench_t bench;
+
+int main(int argc, char **argv){
+    int reps = 200;
+    int a = 1;
+    if (argc > 2 && strcmp(argv[1], "-r") == 0){
+        reps = atoi(argv[2]);
+        a = 3;
+    }
+    if (a >= argc){
+        printf("usage: %s [-r repeats per frame] frames.raw ...\n", argv[0]);
+        return 1;
+    }
+
+    startFrameStream();
+    for(;a<argc;a++){
+        int n = cam_capture_host_load(argv[a]);
+        if (n < 0){
+            printf("could not read frames from %s\n", argv[a]);
+            return 1;
+        }
+        // file name without the directory and .raw
+        const char *name = strrchr(argv[a], '/');
+        name = name ? name + 1 : argv[a];
+        char corpus[64];
+        snprintf(corpus, sizeof(corpus), "%s", name);
+        char *dot = strrchr(corpus, '.');
+        if (dot != NULL) *dot = 0;
+
+        benchReset(&bench);
+        int f;
+        for(f=0;f<n;f++){
+            cam_capture_host_step();
+            cameraFrame_t *frame = acquireFrame();
+            if (frame == NULL){
+                continue;
+            }
+            benchFrame(&bench, frame, reps);
+            releaseFrame(frame);
+        }
+        benchPrint(&bench, corpus);
+    }
+    return 0;
+}
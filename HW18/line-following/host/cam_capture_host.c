@@ -0,0 +1,100 @@
+// Host version of the capture engine: instead of PIO + DMA filling cameraData,
+// the bytes come from a recording of raw RGB565 frames (IMAGESIZEX*IMAGESIZEY*2
+// bytes each, back to back), and the end-of-frame "interrupt" fires when the
+// host program calls cam_capture_host_step(). With CAM_LUMA_ONLY the recorded
+// pixels are turned into Y the way the sensor's YUV mode would.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cam.h"
+#include "cam_capture.h"
+#include "cam_capture_host.h"
+#include "frame_util.h"
+
+static uint8_t *frames = NULL;
+static uint32_t frameBytes = IMAGESIZEX*IMAGESIZEY*2;
+static uint32_t frameCount = 0;
+static uint32_t nextFrame = 0;
+
+static volatile uint8_t *pendingDest = NULL;
+static uint32_t pendingRows = 0;
+static uint32_t pendingRowBytes = 0;
+static int pendingFirstRow = 0;
+
+int cam_capture_host_load(const char *path){
+    FILE *f = fopen(path, "rb");
+    if (f == NULL){
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    free(frames);
+    frames = NULL;
+    frameCount = size / frameBytes;
+    nextFrame = 0;
+    if (frameCount > 0){
+        frames = malloc((size_t)frameCount * frameBytes);
+        if (fread(frames, frameBytes, frameCount, f) != frameCount){
+            frameCount = 0;
+        }
+    }
+    fclose(f);
+    return frameCount > 0 ? (int)frameCount : -1;
+}
+
+uint32_t cam_capture_host_frame_count(void){
+    return frameCount;
+}
+
+void cam_capture_init(void){
+}
+
+void cam_capture_start(volatile uint8_t *dest, uint32_t rows, uint32_t rowBytes){
+    pendingDest = dest;
+    pendingRows = rows;
+    pendingRowBytes = rowBytes;
+    // like the windowed sensor, only hand over the band of rows asked for
+    int rowsInWindow;
+    getCameraWindow(&pendingFirstRow, &rowsInWindow);
+}
+
+void cam_capture_stop(void){
+    pendingDest = NULL;
+}
+
+int cam_capture_host_step(void){
+    volatile uint8_t *dest = pendingDest;
+    if (dest == NULL){
+        return 0;
+    }
+    pendingDest = NULL;
+    cam_frame_start(); // falling VS
+
+    // the recording is always full RGB565 frames
+    uint32_t rows = pendingRows;
+    if (pendingFirstRow + rows > IMAGESIZEY){
+        rows = IMAGESIZEY - pendingFirstRow;
+    }
+    uint32_t n = rows * pendingRowBytes;
+    if (frameCount == 0){
+        // nothing recorded, deliver a black frame
+        for (uint32_t i = 0; i < n; i++) dest[i] = 0;
+    } else {
+        const uint8_t *src = frames + (size_t)nextFrame * frameBytes + pendingFirstRow * IMAGESIZEX*2;
+        for (uint32_t i = 0; i < rows * IMAGESIZEX; i++){
+#if CAM_LUMA_ONLY
+            dest[i] = rgb565ToY(src + 2*i);
+#else
+            dest[2*i] = src[2*i];
+            dest[2*i+1] = src[2*i+1];
+#endif
+        }
+        nextFrame = (nextFrame + 1) % frameCount;
+    }
+    // this may re-arm straight away when streaming
+    cam_frame_complete(pendingRows, n);
+    return 1;
+}
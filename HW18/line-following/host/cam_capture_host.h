@@ -0,0 +1,12 @@
+#ifndef CAM_CAPTURE_HOST_h
+#define CAM_CAPTURE_HOST_h
+
+#include <stdint.h>
+
+// load raw RGB565 frames to replay, returns the number of frames or -1
+int cam_capture_host_load(const char *path);
+uint32_t cam_capture_host_frame_count(void);
+// finish the capture in flight (the end-of-frame interrupt), returns 0 if none was armed
+int cam_capture_host_step(void);
+
+#endif
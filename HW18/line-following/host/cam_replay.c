@@ -0,0 +1,49 @@
+// Runs the line-following vision on recorded frames instead of the camera.
+// usage: cam_replay frames.raw [frames captured per frame processed]
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cam.h"
+#include "cam_capture_host.h"
+#include "cam_stats.h"
+#include "ground.h"
+
+int main(int argc, char **argv){
+    if (argc < 2){
+        printf("usage: %s frames.raw [captures per frame]\n", argv[0]);
+        return 1;
+    }
+    int n = cam_capture_host_load(argv[1]);
+    if (n < 0){
+        printf("could not read frames from %s\n", argv[1]);
+        return 1;
+    }
+    // >1 pretends the vision is slower than the camera, so frames get dropped
+    int captures = argc > 2 ? atoi(argv[2]) : 1;
+
+    startFrameStream();
+    int f;
+    for (f = 0; f < n; f++){
+        int c;
+        for (c = 0; c < captures; c++){
+            cam_capture_host_step();
+        }
+        cameraFrame_t *frame = acquireFrame();
+        if (frame == NULL){
+            continue;
+        }
+        uint32_t t0 = time_us_32();
+        int com = findLineColumn(IMAGESIZEX/2);
+        lineFit_t fit;
+        fitLine(&fit);
+        camStatsRecord(STAT_DETECT, time_us_32() - t0);
+        groundLine_t ground;
+        groundFromFit(&fit, &ground);
+        printf("%lu %d fit %.2f %.3f %d mm %.1f %.3f %lu dropped %lu\r\n", (unsigned long)frame->id, com,
+            REAL_TO_FLOAT(fit.offset), REAL_TO_FLOAT(fit.heading), fit.quality,
+            REAL_TO_FLOAT(ground.side), REAL_TO_FLOAT(ground.slope), (unsigned long)frame->bytes, (unsigned long)frame->dropped);
+        releaseFrame(frame);
+    }
+    camStatsPrint();
+    return 0;
+}
@@ -0,0 +1,313 @@
+// Drives the cam.c GPIO interrupt capture with a simulated OV7670 and checks
+// the frames and the line positions that come out.
+//   cam_sim                  synthetic frames with a known line position
+//   cam_sim frames.raw       replay a recording, check every byte arrives
+//   cam_sim -f [frames.raw]  same with glitches on the bus, must not crash
+// Exits 1 if anything didn't match.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cam.h"
+#include "cam_stats.h"
+#include "ov7670_sim.h"
+#include "blob.h"
+#include "scanline.h"
+#include "pico_host.h"
+#include "frame_util.h"
+
+#define SYNTHETIC_FRAMES 200
+
+static uint8_t rgb[IMAGESIZEX*IMAGESIZEY*2];
+
+int main(int argc, char **argv){
+    int fuzz = 0;
+    const char *path = NULL;
+    int a;
+    for(a=1;a<argc;a++){
+        if (strcmp(argv[a], "-f") == 0) fuzz = 1;
+        else path = argv[a];
+    }
+
+    uint8_t *frames = NULL;
+    int n = SYNTHETIC_FRAMES;
+    if (path != NULL){
+        FILE *f = fopen(path, "rb");
+        if (f == NULL){
+            printf("could not open %s\n", path);
+            return 1;
+        }
+        fseek(f, 0, SEEK_END);
+        n = ftell(f) / sizeof(rgb);
+        fseek(f, 0, SEEK_SET);
+        frames = malloc((size_t)n * sizeof(rgb));
+        if (n == 0 || fread(frames, sizeof(rgb), n, f) != (size_t)n){
+            printf("no frames in %s\n", path);
+            return 1;
+        }
+        fclose(f);
+    }
+
+    if (fuzz){
+        ov7670SimGlitch_t g = {200, 200, 50};
+        ov7670_sim_set_glitch(&g);
+    }
+
+    // registers the GPIO callbacks the simulator drives
+    init_camera_pins();
+    startFrameStream();
+    // the register file is what the sensor would be running with
+#if CAM_LUMA_ONLY
+    uint8_t com7 = OV7670_COM7_YUV;
+#else
+    uint8_t com7 = OV7670_COM7_RGB;
+#endif
+    if ((host_i2c_register(OV7670_REG_COM7) & OV7670_COM7_PIXEL_MASK) != com7){
+        printf("COM7 = 0x%02x, colorspace not set\n", host_i2c_register(OV7670_REG_COM7));
+        return 1;
+    }
+
+    uint32_t seed = 1;
+    int bad = 0;
+    uint64_t t0 = time_us_64();
+    uint64_t visionUs = 0;
+    int i;
+    for(i=0;i<n;i++){
+        int vertical = i & 1;
+        int pos = 0;
+        int slope = 0;
+        int glare = 0;
+        if (frames != NULL){
+            memcpy(rgb, frames + (size_t)i*sizeof(rgb), sizeof(rgb));
+        } else {
+            pos = vertical ? 8 + (i*7) % (IMAGESIZEX - 16) : 12 + (i*5) % (IMAGESIZEY - 24);
+            // row stripes tilt up to 1/4 row per column, for fitLine()
+            slope = vertical ? 0 : 2*((i/2) % 5) - 4;
+            // floor noise, the frame threshold has to sit between floor and line
+            ov7670_sim_synthetic(rgb, vertical, pos, slope, 5, 2, &seed);
+            // every 4th row stripe gets a patch of glare well away from it
+            glare = !vertical && i % 4 == 2;
+            if (glare){
+                int top = pos < IMAGESIZEY/2 ? IMAGESIZEY - 8 : 0;
+                int r, c;
+                for(r=top;r<top+8;r++){
+                    for(c=IMAGESIZEX/2-4;c<IMAGESIZEX/2+4;c++){
+                        rgb[2*(r*IMAGESIZEX + c)] = 0xFF;
+                        rgb[2*(r*IMAGESIZEX + c) + 1] = 0xFF;
+                    }
+                }
+            }
+        }
+        ov7670_sim_send_frame(rgb);
+
+        cameraFrame_t *frame = acquireFrame();
+        if (frame == NULL){
+            if (!fuzz){
+                printf("frame %d: nothing captured\n", i);
+                bad++;
+            }
+            continue;
+        }
+
+        uint32_t len;
+        const uint8_t *want = ov7670_sim_expected(&len);
+        if (!fuzz && (frame->bytes != len || memcmp(frame->data, want, len) != 0)){
+            printf("frame %d: %lu bytes captured, %lu sent, data %s\n", i,
+                (unsigned long)frame->bytes, (unsigned long)len,
+                memcmp(frame->data, want, len) ? "differs" : "matches");
+            bad++;
+        }
+
+        uint64_t v0 = time_us_64();
+        int row = findLine(IMAGESIZEY/2);
+        int col = findLineColumn(IMAGESIZEX/2);
+        lineFit_t fit;
+        fitLine(&fit);
+        // the track was a couple of rows off last frame
+        const blobList_t *blobs = findBlobs(frame);
+        const blob_t *track = pickTrackBlob(blobs, REAL_FROM_INT(pos + 2));
+        lineFit_t blobFit;
+        if (track != NULL){
+            blobFitLine(track, &blobFit);
+        }
+        // only the window around last frame's line, and a prediction that is
+        // far off which has to fall back to the full scan
+        lineFit_t nearFit;
+        int nearPoints = fitLineNear(&nearFit, REAL_FROM_INT(pos + 2), REAL_FRAC(slope, 16), 0);
+        lineFit_t missFit;
+        int off = pos < IMAGESIZEY/2 ? pos + 25 : pos - 25;
+        int missPoints = fitLineNear(&missFit, REAL_FROM_INT(off), 0, 0);
+        visionUs += time_us_64() - v0;
+
+        if (frames == NULL && !fuzz){
+            int got = vertical ? row : col;
+            // the glare sits on the middle column
+            if (!glare && abs(got - pos) > 1){
+                printf("frame %d: line at %d, found %d\n", i, pos, got);
+                bad++;
+            }
+            float heading = atanf(slope / 16.0f);
+            if (!vertical && !glare && (fabsf(REAL_TO_FLOAT(fit.offset) - pos) > 1 ||
+                fabsf(REAL_TO_FLOAT(fit.heading) - heading) > 0.05f || fit.quality < 50)){
+                printf("frame %d: line at %d heading %.3f, fit %.2f heading %.3f quality %d\n",
+                    i, pos, heading, REAL_TO_FLOAT(fit.offset), REAL_TO_FLOAT(fit.heading), fit.quality);
+                bad++;
+            }
+            if (!vertical && (blobs->count != 1 + glare || blobs->truncated || track == NULL ||
+                fabsf(REAL_TO_FLOAT(blobFit.offset) - pos) > 1 ||
+                fabsf(REAL_TO_FLOAT(blobFit.heading) - heading) > 0.05f)){
+                printf("frame %d: line at %d heading %.3f, %d blobs%s, blob fit %.2f heading %.3f\n",
+                    i, pos, heading, blobs->count, blobs->truncated ? " truncated" : "",
+                    track ? REAL_TO_FLOAT(blobFit.offset) : -1.0f, track ? REAL_TO_FLOAT(blobFit.heading) : 0.0f);
+                bad++;
+            }
+            if (!vertical && (nearPoints != CAM_FIT_LINES || missPoints != 0 ||
+                fabsf(REAL_TO_FLOAT(nearFit.offset) - pos) > 1 ||
+                fabsf(REAL_TO_FLOAT(nearFit.heading) - heading) > 0.05f)){
+                printf("frame %d: line at %d heading %.3f, window fit %d points %.2f heading %.3f, far window %d points\n",
+                    i, pos, heading, nearPoints, REAL_TO_FLOAT(nearFit.offset), REAL_TO_FLOAT(nearFit.heading), missPoints);
+                bad++;
+            }
+        }
+        releaseFrame(frame);
+    }
+    uint64_t total = time_us_64() - t0;
+
+    // every kind of track piece has to come out as its topology
+    static const int expect[] = {TOPO_STRAIGHT, TOPO_CURVE, TOPO_FORK, TOPO_CROSS, TOPO_END};
+    uint64_t topoUs = 0;
+    int shapes = 0;
+    for(i=0;i<(frames == NULL && !fuzz ? 50 : 0);i++){
+        int shape = i % 5;
+        int pos = 20 + i % 21;
+        ov7670_sim_track(rgb, shape, pos, 2, &seed);
+        ov7670_sim_send_frame(rgb);
+        cameraFrame_t *frame = acquireFrame();
+        if (frame == NULL){
+            printf("track %d: nothing captured\n", i);
+            bad++;
+            continue;
+        }
+        uint64_t v0 = time_us_64();
+        frameTopology_t topo;
+        analyzeTopology(frame, &topo);
+        lineFit_t low, high, near;
+        followBranch(&topo, BRANCH_LOW, REAL_FROM_INT(pos), &low);
+        followBranch(&topo, BRANCH_HIGH, REAL_FROM_INT(pos), &high);
+        followBranch(&topo, BRANCH_NEAREST, REAL_FROM_INT(pos), &near);
+        topoUs += time_us_64() - v0;
+        shapes++;
+        if (topo.type != expect[shape]){
+            printf("track %d: %s at %d seen as %s\n", i, topologyNames[expect[shape]], pos, topologyNames[topo.type]);
+            bad++;
+        }
+        // the low branch goes up the image, the high one down, and
+        // straight over a crossing stays on the line
+        if (shape == SIM_FORK && (low.heading >= 0 || high.heading <= 0)){
+            printf("track %d: fork branches heading %.3f and %.3f\n", i,
+                REAL_TO_FLOAT(low.heading), REAL_TO_FLOAT(high.heading));
+            bad++;
+        }
+        if (shape == SIM_CROSS && fabsf(REAL_TO_FLOAT(near.offset) - pos) > 1){
+            printf("track %d: crossing at %d followed at %.2f\n", i, pos, REAL_TO_FLOAT(near.offset));
+            bad++;
+        }
+        // the curve bends 1/100 row per column squared, and the windows
+        // following the bend find all of it, the ends too
+        if (shape == SIM_CURVE){
+            lineFit_t full, bent;
+            fitLine(&full);
+            int bentPoints = fitLineNear(&bent, full.offset, full.slope, full.curvature);
+            if (fabsf(REAL_TO_FLOAT(full.curvature) - 0.01f) > 0.002f || bentPoints != CAM_FIT_LINES ||
+                fabsf(REAL_TO_FLOAT(bent.offset) - REAL_TO_FLOAT(full.offset)) > 0.5f ||
+                fabsf(REAL_TO_FLOAT(bent.heading) - REAL_TO_FLOAT(full.heading)) > 0.05f){
+                printf("track %d: curve at %d bends %.4f, window fit %d points %.2f heading %.3f\n", i, pos,
+                    REAL_TO_FLOAT(full.curvature), bentPoints, REAL_TO_FLOAT(bent.offset), REAL_TO_FLOAT(bent.heading));
+                bad++;
+            }
+        }
+        releaseFrame(frame);
+    }
+    if (shapes){
+        printf("%d track pieces, %.2f us/frame topology\n", shapes, (double)topoUs / shapes);
+    }
+
+    // floor only, made like corpus/noline.raw: the threshold passes nothing
+    // and the fit has quality 0, not a line in the noise
+    int floors = 0;
+    for(i=0;i<(frames == NULL && !fuzz ? 32 : 0);i++){
+        ov7670_sim_track(rgb, SIM_NONE, 0, 2 + i % 3, &seed);
+        ov7670_sim_send_frame(rgb);
+        cameraFrame_t *frame = acquireFrame();
+        if (frame == NULL){
+            printf("floor %d: nothing captured\n", i);
+            bad++;
+            continue;
+        }
+        lineFit_t fit;
+        fitLine(&fit);
+        floors++;
+        if (frame->threshold <= CAM_BRIGHT_MAX || fit.quality != 0){
+            printf("floor %d: threshold %d, a line fit with quality %d\n", i, frame->threshold, fit.quality);
+            bad++;
+        }
+        releaseFrame(frame);
+    }
+    if (floors){
+        printf("%d floor only frames\n", floors);
+    }
+
+    // a new window while streaming: the slot armed before the change is
+    // captured again, every frame that comes out holds the band it is
+    // labelled with, and the new band comes within two frames
+    static const int windows[][2] = {{10, 20}, {0, CAM_BUFFER_ROWS}, {30, 8}, {4, 40}};
+    int w;
+    for(w=0;w<(frames == NULL && !fuzz ? 4 : 0);w++){
+        // gray rows getting brighter down the image, every row different
+        int r, c;
+        for(r=0;r<IMAGESIZEY;r++){
+            uint16_t g = (uint16_t)(r*4);
+            uint16_t px = (uint16_t)(((g >> 3) << 11) | ((g >> 2) << 5) | (g >> 3));
+            for(c=0;c<IMAGESIZEX;c++){
+                rgb[2*(r*IMAGESIZEX + c)] = px & 0xFF;
+                rgb[2*(r*IMAGESIZEX + c) + 1] = px >> 8;
+            }
+        }
+        setCameraWindow(windows[w][0], windows[w][1]);
+        int k, seen = 0;
+        for(k=0;k<2;k++){
+            ov7670_sim_send_frame(rgb);
+            cameraFrame_t *frame = acquireFrame();
+            if (frame == NULL){
+                continue;
+            }
+            int wrong = frame->bytes != (uint32_t)frame->rows*CAM_ROW_BYTES;
+            for(r=0;r<frame->rows && !wrong;r++){
+                const uint8_t *src = rgb + 2*(frame->firstRow + r)*IMAGESIZEX;
+#if CAM_LUMA_ONLY
+                wrong = frame->data[r*CAM_ROW_BYTES] != rgb565ToY(src);
+#else
+                wrong = memcmp(frame->data + r*CAM_ROW_BYTES, src, CAM_ROW_BYTES) != 0;
+#endif
+            }
+            if (wrong){
+                printf("window %d %d: frame labelled rows %d + %d holds other rows\n",
+                    windows[w][0], windows[w][1], frame->firstRow, frame->rows);
+                bad++;
+            }
+            seen = seen || (frame->firstRow == windows[w][0] && frame->rows == windows[w][1]);
+            releaseFrame(frame);
+        }
+        if (!seen){
+            printf("window %d %d: never came\n", windows[w][0], windows[w][1]);
+            bad++;
+        }
+    }
+
+    printf("%d frames, %d bad, %.1f us/frame total, %.2f us/frame vision\n",
+        n, bad, (double)total / n, (double)visionUs / n);
+    camStatsPrint();
+    free(frames);
+    return bad ? 1 : 0;
+}
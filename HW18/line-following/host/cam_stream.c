@@ -0,0 +1,37 @@
+// Replays recorded frames and writes them to stdout as binary frame packets,
+// e.g. cam_stream frames.raw d > frames.bin to try the python frame reader.
+// The optional second argument is a stream command letter: r, b or d.
+#include <stdio.h>
+
+#include "cam.h"
+#include "cam_capture_host.h"
+#include "frame_stream.h"
+
+int main(int argc, char **argv){
+    if (argc < 2){
+        fprintf(stderr, "usage: %s frames.raw [r|b|d] > frames.bin\n", argv[0]);
+        return 1;
+    }
+    int n = cam_capture_host_load(argv[1]);
+    if (n < 0){
+        fprintf(stderr, "could not read frames from %s\n", argv[1]);
+        return 1;
+    }
+
+    if (argc > 2){
+        streamCommand(argv[2][0]);
+    }
+    streamCommand('v'); // every frame
+
+    startFrameStream();
+    int f;
+    for (f = 0; f < n; f++){
+        cam_capture_host_step();
+        cameraFrame_t *frame = acquireFrame();
+        int com = findLineColumn(IMAGESIZEX/2);
+        printf("%d\r\n", com); // text in between, like the robot
+        streamFrame(frame);
+        releaseFrame(frame);
+    }
+    return 0;
+}
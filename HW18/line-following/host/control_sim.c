@@ -0,0 +1,184 @@
+// Closes the loop around control.c: a differential drive robot next to a
+// straight line, seen by a 30 fps camera with jitter and latency through
+// tracker.c, steered by controlStep() at CONTROL_HZ through the wheel speed
+// loop in motor_control.c and the motors and encoders of host/motor_sim.c.
+// Checks that it settles onto the line, that a weak motor or a draining
+// battery doesn't pull it off, and that the integral stays bounded while
+// the wheels are at their limits.
+//   control_sim      exits 1 if anything is off
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "control.h"
+#include "ground.h"
+#include "motor_control.h"
+#include "encoder.h"
+#include "motor_sim.h"
+
+#define SIM_STEP_US 500
+#define FRAME_US 33333     // 30 fps, +-FRAME_JITTER_US
+#define FRAME_JITTER_US 8000
+#define LATENCY_US 20000   // exposure to the tracker update
+#define TRACK_MM 100.0f    // between the wheels
+
+typedef struct robot{
+    float y;     // mm right of the line
+    float psi;   // heading, radians clockwise from the line
+} robot_t;
+
+static uint32_t seed = 1;
+
+static void move(robot_t *r, float dt){
+    motorSimStep(dt);
+    float vl = motorSimSpeed(ENCODER_LEFT);
+    float vr = motorSimSpeed(ENCODER_RIGHT);
+    float v = (vl + vr) / 2;
+    r->psi = r->psi + (vl - vr) / TRACK_MM * dt;
+    r->y = r->y + v * sinf(r->psi) * dt;
+}
+
+// the line as the camera sees it: across on the center column, and the
+// line's floor slope, the controller's target row being straight on
+static lineFit_t look(const robot_t *r, real_t *slope){
+    int mid = IMAGESIZEX / 2;
+    float ahead = REAL_TO_FLOAT(groundAhead(mid));
+    float side = -r->y - ahead * tanf(r->psi);
+    seed = seed*1103515245 + 12345;
+    float noise = ((int)((seed >> 16) % 101) - 50) / 100.0f; // +-0.5 row
+    lineFit_t fit;
+    fit.offset = (real_t)((CONTROL_TARGET_ROW + side / REAL_TO_FLOAT(groundMmPerRow(mid)) + noise) * REAL_ONE);
+    fit.heading = 0;
+    fit.slope = 0;
+    fit.quality = 80;
+    fit.points = CAM_FIT_LINES;
+    if (fit.offset < 0 || fit.offset >= REAL_FROM_INT(IMAGESIZEY)){
+        // out of the picture
+        fit.quality = 0;
+        fit.points = 0;
+    }
+    *slope = (real_t)(-tanf(r->psi) * REAL_ONE);
+    return fit;
+}
+
+typedef struct result{
+    float maxY;         // after settling
+    float finalY;
+    float maxIntegral;  // mm/s
+    uint32_t ticks;
+} result_t;
+
+// run for us microseconds from y0 mm off the line, the battery going from
+// volts to endVolts
+static result_t run(float y0, float weakLeft, float volts, float endVolts, uint32_t us){
+    robot_t r = {y0, 0};
+    lineTrack_t t;
+    trackReset(&t);
+    motor_init();
+    motorSimReset(volts);
+    motorSimSetFactor(ENCODER_LEFT, weakLeft);
+    motor_speed_init();
+    controlReset();
+    result_t res = {0};
+
+    uint32_t now = 1000;
+    uint32_t nextFrame = now;
+    uint32_t nextTick = now;
+    // frames in flight: taken at shotTime, tracked at shotTime + LATENCY_US
+    int pending = 0;
+    lineFit_t pendingFit;
+    real_t pendingSlope = 0;
+    uint32_t shotTime = 0;
+    int left, right;
+
+    for(;now < 1000 + us; now += SIM_STEP_US){
+        motorSimSetBattery(volts + (endVolts - volts) * (now - 1000) / us);
+        if ((int32_t)(now - nextFrame) >= 0){
+            seed = seed*1103515245 + 12345;
+            int jitter = (int)((seed >> 16) % (2*FRAME_JITTER_US + 1)) - FRAME_JITTER_US;
+            nextFrame = now + FRAME_US + jitter;
+            pendingFit = look(&r, &pendingSlope);
+            shotTime = now;
+            pending = 1;
+        }
+        if (pending && now - shotTime >= LATENCY_US){
+            trackUpdate(&t, &pendingFit, shotTime);
+            controlPublish(&t, pendingSlope, 0);
+            pending = 0;
+        }
+        if ((int32_t)(now - nextTick) >= 0){
+            nextTick = nextTick + CONTROL_PERIOD_US;
+            // what controlTick() does
+            controlStep(now, &left, &right);
+            motor_speed_set(left, right);
+            motor_speed_update(CONTROL_PERIOD_US);
+            res.ticks++;
+            controlStatus_t s;
+            controlGetStatus(&s);
+            float integral = fabsf(REAL_TO_FLOAT(s.integral));
+            if (integral > res.maxIntegral) res.maxIntegral = integral;
+        }
+        move(&r, SIM_STEP_US * 1e-6f);
+        if (now - 1000 > us / 2 && fabsf(r.y) > res.maxY){
+            res.maxY = fabsf(r.y);
+        }
+    }
+    res.finalY = r.y;
+    return res;
+}
+
+int main(){
+    int bad = 0;
+    float deadband = REAL_TO_FLOAT(CONTROL_DEADBAND);
+
+    // off to either side as far as the camera sees, settled within the
+    // deadband over the second half
+    float starts[] = {40.0f, -25.0f};
+    int i;
+    for(i=0;i<2;i++){
+        result_t res = run(starts[i], 1.0f, 7.4f, 7.4f, 6000000);
+        printf("from %.0f mm: %.1f mm at the end, at most %.1f mm over the last 3 s, integral up to %.1f mm/s\n",
+            starts[i], res.finalY, res.maxY, res.maxIntegral);
+        if (res.maxY > deadband + 2){
+            printf("did not settle onto the line\n");
+            bad++;
+        }
+        // the ticks come at the control rate, whatever the frames do
+        uint32_t want = 6000000 / CONTROL_PERIOD_US;
+        if (res.ticks < want - 1 || res.ticks > want + 1){
+            printf("%lu ticks, wanted %lu\n", (unsigned long)res.ticks, (unsigned long)want);
+            bad++;
+        }
+    }
+
+    // a 10% weaker left wheel, the speed loop holds the robot on the line
+    result_t weak = run(0.0f, 0.9f, 7.4f, 7.4f, 10000000);
+    printf("weak left wheel: %.1f mm at the end, at most %.1f mm over the last 5 s, integral up to %.1f mm/s\n",
+        weak.finalY, weak.maxY, weak.maxIntegral);
+    if (weak.maxY > deadband + 2){
+        printf("drifts off with a weak wheel\n");
+        bad++;
+    }
+
+    // far off and a much weaker wheel, the wheels sit at their limits for a
+    // while: the integral stays inside its clamp and the robot still settles
+    result_t far = run(45.0f, 0.8f, 7.4f, 7.4f, 8000000);
+    printf("from 45 mm, 20%% weaker left wheel: %.1f mm at the end, at most %.1f mm over the last 4 s, integral up to %.1f mm/s\n",
+        far.finalY, far.maxY, far.maxIntegral);
+    if (far.maxIntegral > REAL_TO_FLOAT(CONTROL_I_MAX) + 0.01f || far.maxY > deadband + 2){
+        printf("winds up\n");
+        bad++;
+    }
+
+    // full to flat while following, the same gains have to do
+    result_t drain = run(40.0f, 1.0f, 8.4f, 6.8f, 10000000);
+    printf("from 40 mm, battery 8.4 to 6.8 V: %.1f mm at the end, at most %.1f mm over the last 5 s\n",
+        drain.finalY, drain.maxY);
+    if (drain.maxY > deadband + 2){
+        printf("loses the line as the battery drains\n");
+        bad++;
+    }
+
+    printf("%d bad\n", bad);
+    return bad ? 1 : 0;
+}
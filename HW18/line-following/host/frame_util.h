@@ -0,0 +1,15 @@
+#ifndef FRAME_UTIL_h
+#define FRAME_UTIL_h
+
+#include <stdint.h>
+
+// BT.601 luma of a packed RGB565 pixel (low byte first), what the
+// sensor's YUV mode would send for it
+static inline uint8_t rgb565ToY(const uint8_t *p){
+    int r = (p[1]>>3)<<3;
+    int g = (((p[1]&0b111)<<3) | p[0]>>5)<<2;
+    int b = (p[0]&0b11111)<<3;
+    return (uint8_t)((77*r + 150*g + 29*b) >> 8);
+}
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef HOST_HARDWARE_CLOCKS_h
+#define HOST_HARDWARE_CLOCKS_h
+
+#include "pico/stdlib.h"
+
+enum clock_index { clk_sys = 5 };
+
+// the RP2350's 150 MHz
+uint32_t clock_get_hz(enum clock_index clk_index);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef HOST_HARDWARE_IRQ_h
+#define HOST_HARDWARE_IRQ_h
+
+#include "pico/stdlib.h"
+
+// handlers are kept and run by the host models that raise them, see
+// host_pwm_wrap() in pico_host.h
+typedef void (*irq_handler_t)(void);
+
+#define PWM_IRQ_WRAP 4
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority);
+void irq_set_enabled(uint num, bool enabled);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef HOST_HARDWARE_PWM_h
+#define HOST_HARDWARE_PWM_h
+
+#include "pico/stdlib.h"
+#include "hardware/irq.h"
+
+#define NUM_PWM_SLICES 8
+#define PWM_DEFAULT_IRQ_NUM() PWM_IRQ_WRAP
+
+// the one register the firmware reads directly, which slices are running
+typedef struct pwm_hw{
+    uint32_t en;
+} pwm_hw_t;
+extern pwm_hw_t host_pwm_hw;
+#define pwm_hw (&host_pwm_hw)
+
+uint pwm_gpio_to_slice_num(uint gpio);
+uint pwm_gpio_to_channel(uint gpio);
+void pwm_set_clkdiv(uint slice_num, float divider);
+void pwm_set_clkdiv_int_frac(uint slice_num, uint8_t integer, uint8_t fract);
+void pwm_set_wrap(uint slice_num, uint16_t wrap);
+void pwm_set_phase_correct(uint slice_num, bool phase_correct);
+void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level);
+void pwm_set_both_levels(uint slice_num, uint16_t level_a, uint16_t level_b);
+void pwm_set_gpio_level(uint gpio, uint16_t level);
+void pwm_set_enabled(uint slice_num, bool enabled);
+void pwm_set_mask_enabled(uint32_t mask);
+void pwm_set_counter(uint slice_num, uint16_t c);
+uint16_t pwm_get_counter(uint slice_num);
+void pwm_set_irq_enabled(uint slice_num, bool enabled);
+void pwm_clear_irq(uint slice_num);
+uint32_t pwm_get_irq_status_mask(void);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef HOST_HARDWARE_SYNC_h
+#define HOST_HARDWARE_SYNC_h
+
+#include "pico/stdlib.h"
+
+// the host "interrupts" run from the main thread, nothing to mask
+static inline uint32_t save_and_disable_interrupts(void){ return 0; }
+static inline void restore_interrupts(uint32_t status){ (void)status; }
+
+// host programs are core 0, the ones that play core 1 use a thread
+static inline uint get_core_num(void){ return 0; }
+static inline void __dmb(void){ __sync_synchronize(); }
+
+// spin locks between the cores, a flag the host threads spin on
+typedef volatile uint32_t spin_lock_t;
+static inline int spin_lock_claim_unused(bool required){
+    static int next = 0;
+    if (next == 32){
+        if (required) abort();
+        return -1;
+    }
+    return next++;
+}
+static inline spin_lock_t *spin_lock_init(uint lock_num){
+    static spin_lock_t locks[32];
+    locks[lock_num] = 0;
+    return &locks[lock_num];
+}
+static inline uint32_t spin_lock_blocking(spin_lock_t *lock){
+    while (__sync_lock_test_and_set(lock, 1)){
+    }
+    return 0;
+}
+static inline void spin_unlock(spin_lock_t *lock, uint32_t saved_irq){
+    (void)saved_irq;
+    __sync_lock_release(lock);
+}
+
+#endif
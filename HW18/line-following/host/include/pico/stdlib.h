@@ -0,0 +1,53 @@
+#ifndef HOST_PICO_STDLIB_h
+#define HOST_PICO_STDLIB_h
+
+// Minimal stand-in for the pico SDK so the camera and vision code builds on Linux.
+// Only what the line-following sources call is declared here, see pico_stub.c.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "pico/types.h"
+
+#define GPIO_IN false
+#define GPIO_OUT true
+
+#define __isr
+#define tight_loop_contents() do {} while (0)
+
+#define PICO_ERROR_TIMEOUT -1
+
+// on even in release builds, like the SDK's
+#define hard_assert(x) do { if (!(x)) abort(); } while (0)
+
+// stdio goes to the terminal, getchar_timeout_us never has input
+int stdio_put_string(const char *s, int len, bool newline, bool cr_translation);
+void stdio_flush(void);
+int getchar_timeout_us(uint32_t timeout_us);
+
+void sleep_ms(uint32_t ms);
+void sleep_us(uint64_t us);
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+
+// repeating timers are accepted but never fire, host programs call the
+// tick functions themselves with simulated time
+struct repeating_timer;
+typedef bool (*repeating_timer_callback_t)(struct repeating_timer *rt);
+struct repeating_timer{
+    int64_t delay_us;
+    repeating_timer_callback_t callback;
+    void *user_data;
+};
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data, struct repeating_timer *out);
+bool cancel_repeating_timer(struct repeating_timer *timer);
+// a pool's alarms fire on the core that created it
+typedef struct alarm_pool alarm_pool_t;
+alarm_pool_t *alarm_pool_create_with_unused_hardware_alarm(uint max_timers);
+bool alarm_pool_add_repeating_timer_us(alarm_pool_t *pool, int64_t delay_us, repeating_timer_callback_t callback, void *user_data, struct repeating_timer *out);
+
+// like the SDK's pico/stdlib.h
+#include "hardware/gpio.h"
+
+#endif
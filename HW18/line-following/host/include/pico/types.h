@@ -0,0 +1,11 @@
+#ifndef HOST_PICO_TYPES_h
+#define HOST_PICO_TYPES_h
+
+// the SDK's shorthand types, pico/stdlib.h includes this as the SDK's does
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef unsigned int uint;
+
+#endif
@@ -0,0 +1,104 @@
+// Two threads through mailbox.h, as core 0 posting estimates and core 1
+// taking them: every copy the reader gets must be one whole post, newer or
+// the same as the last, and the reader must keep getting them while the
+// writer never waits for it.
+//   mailbox_sim      exits 1 if anything is off
+#include <stdio.h>
+#include <pthread.h>
+
+#include "mailbox.h"
+
+#define POSTS 200000
+#define WORK 2000 // loop rounds between posts, the firmware posts at 30 fps
+
+// filled in from one number, a torn copy has fields from two
+typedef struct estimate{
+    uint32_t n;
+    uint32_t words[30];
+    uint32_t check;
+} estimate_t;
+
+static mailbox_t box;
+static estimate_t slot;
+static volatile int writing = 1;
+
+static void fill(estimate_t *e, uint32_t n){
+    int i;
+    e->n = n;
+    for(i=0;i<30;i++){
+        e->words[i] = n*31 + i;
+    }
+    e->check = ~n;
+}
+
+static int whole(const estimate_t *e){
+    int i;
+    for(i=0;i<30;i++){
+        if (e->words[i] != e->n*31 + i) return 0;
+    }
+    return e->check == ~e->n;
+}
+
+static void *writer(void *arg){
+    (void)arg;
+    uint32_t n;
+    for(n=1;n<=POSTS;n++){
+        estimate_t e;
+        fill(&e, n);
+        mailboxPost(&box, &slot, &e, sizeof(e));
+        // the next frame: a reader that always lands inside a post would
+        // never get one, real posts come 33 ms apart
+        volatile int work;
+        for(work=0;work<WORK;work++){
+        }
+    }
+    writing = 0;
+    return NULL;
+}
+
+int main(){
+    int bad = 0;
+    mailboxReset(&box);
+    pthread_t thread;
+    pthread_create(&thread, NULL, writer, NULL);
+
+    uint32_t takes = 0, missed = 0, torn = 0, last = 0, lastSeq = 0;
+    while (writing){
+        estimate_t e;
+        uint32_t seq = mailboxTake(&box, &slot, &e, sizeof(e));
+        if (seq == 0){
+            missed++;
+            continue;
+        }
+        takes++;
+        if (!whole(&e)){
+            torn++;
+        }
+        // the sequence number is the post the copy came from
+        if (e.n < last || seq < lastSeq || seq != e.n){
+            bad++;
+        }
+        last = e.n;
+        lastSeq = seq;
+    }
+    pthread_join(thread, NULL);
+
+    estimate_t e;
+    uint32_t seq = mailboxTake(&box, &slot, &e, sizeof(e));
+    printf("%lu takes, %lu missed a post in progress, %lu torn, last seq %lu\n",
+        (unsigned long)takes, (unsigned long)missed, (unsigned long)torn, (unsigned long)seq);
+    if (torn){
+        printf("a copy mixed two posts\n");
+        bad++;
+    }
+    if (seq != POSTS || e.n != POSTS){
+        printf("the last post isn't there\n");
+        bad++;
+    }
+    if (takes == 0){
+        printf("the reader never got through\n");
+        bad++;
+    }
+    printf("%d bad\n", bad);
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,74 @@
+// Writes the benchmark corpus for cam_bench, CORPUS_FRAMES synthetic 80x60
+// RGB565 frames per file in the cam_capture_host_load() format:
+//   straight.raw  tilted straight line, different rows and angles
+//   curve.raw     bending line
+//   glare.raw     tilted line with a patch of glare away from it
+//   noline.raw    floor only
+// usage: make_corpus dir
+// Frames recorded on the robot (python/record_frames.py) go in the same format.
+#include <stdio.h>
+#include <string.h>
+
+#include "cam.h"
+#include "ov7670_sim.h"
+
+#define CORPUS_FRAMES 32
+
+static uint8_t rgb[IMAGESIZEX*IMAGESIZEY*2];
+
+enum { CORPUS_STRAIGHT = 0, CORPUS_CURVE, CORPUS_GLARE, CORPUS_NOLINE, CORPUS_COUNT };
+static const char *corpusNames[CORPUS_COUNT] = {"straight", "curve", "glare", "noline"};
+
+static void makeFrame(int kind, int i, uint32_t *seed){
+    int pos = 12 + (i*5) % (IMAGESIZEY - 24);
+    int slope = 2*(i % 5) - 4; // up to 1/4 row per column
+    switch (kind){
+    case CORPUS_STRAIGHT:
+        ov7670_sim_synthetic(rgb, 0, pos, slope, 5, 2, seed);
+        break;
+    case CORPUS_CURVE:
+        ov7670_sim_track(rgb, SIM_CURVE, pos - 8, 2, seed);
+        break;
+    case CORPUS_GLARE: {
+        ov7670_sim_synthetic(rgb, 0, pos, slope, 5, 2, seed);
+        // the far side of the image from the line, across the middle columns
+        int top = pos < IMAGESIZEY/2 ? IMAGESIZEY - 8 : 0;
+        int r, c;
+        for(r=top;r<top+8;r++){
+            for(c=IMAGESIZEX/2-4;c<IMAGESIZEX/2+4;c++){
+                rgb[2*(r*IMAGESIZEX + c)] = 0xFF;
+                rgb[2*(r*IMAGESIZEX + c) + 1] = 0xFF;
+            }
+        }
+        break;
+    }
+    default:
+        ov7670_sim_track(rgb, SIM_NONE, 0, 2, seed);
+        break;
+    }
+}
+
+int main(int argc, char **argv){
+    if (argc < 2){
+        printf("usage: %s dir\n", argv[0]);
+        return 1;
+    }
+    int kind;
+    for(kind=0;kind<CORPUS_COUNT;kind++){
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s.raw", argv[1], corpusNames[kind]);
+        FILE *f = fopen(path, "wb");
+        if (f == NULL){
+            printf("could not write %s\n", path);
+            return 1;
+        }
+        uint32_t seed = 1 + kind; // the same corpus every time
+        int i;
+        for(i=0;i<CORPUS_FRAMES;i++){
+            makeFrame(kind, i, &seed);
+            fwrite(rgb, sizeof(rgb), 1, f);
+        }
+        fclose(f);
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <math.h>
+
+#include "pico_host.h"
+#include "motor_control.h"
+#include "encoder.h"
+#include "motor_sim.h"
+
+static float battery;
+static float speed[2];     // mm/s, forward positive
+static float distance[2];  // mm since the reset
+static float factor[2] = {1.0f, 1.0f};
+
+void motorSimReset(float volts){
+    battery = volts;
+    int i;
+    for(i=0;i<2;i++){
+        speed[i] = 0;
+        distance[i] = 0;
+        factor[i] = 1.0f;
+    }
+}
+
+void motorSimSetBattery(float volts){
+    battery = volts;
+}
+
+void motorSimSetFactor(int wheel, float f){
+    factor[wheel] = f;
+}
+
+// where the wheel is heading with this share of the battery across it
+static float steadySpeed(float drive, float f){
+    float volts = drive * battery;
+    float over = fabsf(volts) - MOTOR_SIM_STALL_V;
+    if (over <= 0){
+        return 0;
+    }
+    float v = over * MOTOR_SIM_MM_PER_S_PER_V * f;
+    return volts > 0 ? v : -v;
+}
+
+void motorSimStep(float dt){
+    // a step is many PWM periods: the wrap interrupt writes what the speed
+    // loop committed, the wrap after takes it
+    host_pwm_wrap();
+    host_pwm_wrap();
+    // motor A is mounted the other way round, forward is AIN2
+    float drive[2];
+    drive[ENCODER_LEFT] = host_pwm_duty(AIN2) - host_pwm_duty(AIN1);
+    drive[ENCODER_RIGHT] = host_pwm_duty(BIN1) - host_pwm_duty(BIN2);
+    int i;
+    for(i=0;i<2;i++){
+        float target = steadySpeed(drive[i], factor[i]);
+        speed[i] = speed[i] + (target - speed[i]) * dt / MOTOR_SIM_TAU;
+        distance[i] = distance[i] + speed[i] * dt;
+    }
+}
+
+float motorSimSpeed(int wheel){
+    return speed[wheel];
+}
+
+void encoder_init(void){
+}
+
+// the PIO's count: whole edges, with the encoder's mounting direction
+int32_t encoder_count(int wheel){
+    float edges = distance[wheel] / REAL_TO_FLOAT(WHEEL_MM_PER_COUNT);
+    int dir = wheel == ENCODER_LEFT ? ENCODER_LEFT_DIR : ENCODER_RIGHT_DIR;
+    return dir * (int32_t)floorf(edges);
+}
@@ -0,0 +1,25 @@
+#ifndef MOTOR_SIM_h
+#define MOTOR_SIM_h
+
+// Two DC gear motors behind the DRV8833 and their encoders. The drive
+// voltage comes from the PWM levels motor_control.c set on the AIN/BIN pins
+// (host_pwm_duty), the wheels turn with a first order lag, and the encoder
+// counts they make are what encoder_count() returns (this file stands in
+// for encoder.c). At MOTOR_SIM_NOMINAL_V a wheel does (duty - 30) * 5 mm/s.
+
+#define MOTOR_SIM_NOMINAL_V 7.4f  // 2S LiPo, 8.4 full and about 6.8 flat
+#define MOTOR_SIM_STALL_V 2.22f   // below this the gearbox doesn't turn
+#define MOTOR_SIM_MM_PER_S_PER_V 67.6f
+#define MOTOR_SIM_TAU 0.05f       // s, wheel speed time constant
+
+// battery volts, both wheels stopped and the counts at 0
+void motorSimReset(float battery);
+void motorSimSetBattery(float battery);
+// wheel speed factor, e.g. 0.9 for a weaker left motor
+void motorSimSetFactor(int wheel, float factor);
+// run the motors dt seconds on the current PWM levels
+void motorSimStep(float dt);
+// mm/s of the wheel on the floor, forward positive
+float motorSimSpeed(int wheel);
+
+#endif
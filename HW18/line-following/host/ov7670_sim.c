@@ -0,0 +1,150 @@
+#include <stdlib.h>
+
+#include "cam.h"
+#include "pico_host.h"
+#include "ov7670_sim.h"
+#include "frame_util.h"
+
+static ov7670SimGlitch_t glitch;
+static uint32_t glitchSeed = 12345;
+static uint8_t expected[IMAGESIZEX*IMAGESIZEY*2];
+static uint32_t expectedLen = 0;
+
+static uint32_t nextRandom(uint32_t *seed){
+    // xorshift32
+    uint32_t x = *seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    return x;
+}
+
+static int chance(uint32_t perMillion){
+    return perMillion && (nextRandom(&glitchSeed) % 1000000) < perMillion;
+}
+
+void ov7670_sim_set_glitch(const ov7670SimGlitch_t *g){
+    glitch = *g;
+}
+
+static uint32_t pins = 0;
+
+static void setPin(uint gpio, int level){
+    if (level) pins |= 1u << gpio;
+    else pins &= ~(1u << gpio);
+    host_gpio_set_inputs(pins);
+}
+
+// one clocked byte: data changes while PCLK is low, sampled on the rise
+static void pclkByte(uint8_t b){
+    setPin(PCLK, 0);
+    pins = (pins & ~0xFFu) | b; // D0-D7 on GP0-GP7
+    host_gpio_set_inputs(pins);
+    setPin(PCLK, 1);
+    host_gpio_edge(PCLK, GPIO_IRQ_EDGE_RISE);
+}
+
+static void hsRise(){
+    setPin(HS, 0);
+    setPin(HS, 1);
+    host_gpio_edge(HS, GPIO_IRQ_EDGE_RISE);
+}
+
+void ov7670_sim_send_frame(const uint8_t *rgb565){
+    int firstRow, rows;
+    getCameraWindow(&firstRow, &rows);
+
+    // VSYNC pulse, the frame starts on the falling edge
+    setPin(VS, 1);
+    host_gpio_edge(VS, GPIO_IRQ_EDGE_RISE);
+    setPin(VS, 0);
+    host_gpio_edge(VS, GPIO_IRQ_EDGE_FALL);
+
+    expectedLen = 0;
+    int row, col;
+    for(row=firstRow;row<firstRow+rows;row++){
+        hsRise();
+        for(col=0;col<IMAGESIZEX;col++){
+            const uint8_t *p = rgb565 + 2*(row*IMAGESIZEX + col);
+            uint8_t bus[2];
+#if CAM_LUMA_ONLY
+            bus[0] = 0x80; // U or V, gray
+            bus[1] = rgb565ToY(p);
+            expected[expectedLen++] = bus[1];
+#else
+            bus[0] = p[0];
+            bus[1] = p[1];
+            expected[expectedLen++] = bus[0];
+            expected[expectedLen++] = bus[1];
+#endif
+            int k;
+            for(k=0;k<2;k++){
+                if (chance(glitch.extraHs)){
+                    hsRise();
+                }
+                if (chance(glitch.extraPclk)){
+                    pclkByte(nextRandom(&glitchSeed) & 0xFF);
+                }
+                if (chance(glitch.dropPclk)){
+                    continue;
+                }
+                pclkByte(bus[k]);
+            }
+        }
+        setPin(HS, 0); // end of row
+    }
+}
+
+const uint8_t *ov7670_sim_expected(uint32_t *len){
+    *len = expectedLen;
+    return expected;
+}
+
+// one gray pixel, floor (6) or line (28) plus noise
+static void setGray(uint8_t *rgb565, int row, int col, int line, int noise, uint32_t *seed){
+    int v = line ? 28 : 6; // 0..31 gray level
+    if (noise){
+        v = v + (int)(nextRandom(seed) % (2*noise + 1)) - noise;
+    }
+    if (v < 0) v = 0;
+    if (v > 31) v = 31;
+    // same level in all three channels, green has one more bit
+    uint16_t px = (v << 11) | ((v*2) << 5) | v;
+    rgb565[2*(row*IMAGESIZEX + col)] = px & 0xFF;
+    rgb565[2*(row*IMAGESIZEX + col) + 1] = px >> 8;
+}
+
+void ov7670_sim_synthetic(uint8_t *rgb565, int vertical, int pos, int slope, int w, int noise, uint32_t *seed){
+    int row, col;
+    for(row=0;row<IMAGESIZEY;row++){
+        for(col=0;col<IMAGESIZEX;col++){
+            int d = vertical ? 16*(col - pos) - slope*(row - IMAGESIZEY/2)
+                             : 16*(row - pos) - slope*(col - IMAGESIZEX/2);
+            d = d / 16;
+            setGray(rgb565, row, col, abs(d) <= w/2, noise, seed);
+        }
+    }
+}
+
+void ov7670_sim_track(uint8_t *rgb565, int shape, int pos, int noise, uint32_t *seed){
+    int row, col;
+    int mid = IMAGESIZEX / 2;
+    for(row=0;row<IMAGESIZEY;row++){
+        for(col=0;col<IMAGESIZEX;col++){
+            int line = abs(row - pos) <= 2;
+            if (shape == SIM_CURVE){
+                line = abs(row - pos - (col - mid)*(col - mid)/100) <= 2;
+            } else if (shape == SIM_FORK && col >= mid){
+                line = abs(row - pos + (col - mid)/2) <= 2 || abs(row - pos - (col - mid)/2) <= 2;
+            } else if (shape == SIM_CROSS){
+                line = line || abs(col - IMAGESIZEX*3/10) <= 2;
+            } else if (shape == SIM_END){
+                line = line && col < mid;
+            } else if (shape == SIM_NONE){
+                line = 0;
+            }
+            setGray(rgb565, row, col, line, noise, seed);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef OV7670_SIM_h
+#define OV7670_SIM_h
+
+#include <stdint.h>
+
+// Simulated OV7670 on the parallel bus: turns a frame into the VS/HS/PCLK
+// edges and data bytes the real sensor would produce, delivered through the
+// GPIO interrupt callback that init_camera_pins() registered.
+// Needs cam.c built with CAM_CAPTURE_PIO=0.
+
+// glitches per million PCLK edges, for fuzzing the capture state machine
+typedef struct ov7670SimGlitch{
+    uint32_t dropPclk;  // a PCLK edge that never arrives
+    uint32_t extraPclk; // a spurious PCLK edge with garbage on the bus
+    uint32_t extraHs;   // a spurious HS edge
+} ov7670SimGlitch_t;
+
+void ov7670_sim_set_glitch(const ov7670SimGlitch_t *g);
+
+// Send one full 80x60 RGB565 frame (low byte first). Only the rows in the
+// camera window are sent, and with CAM_LUMA_ONLY the bytes are U Y V Y.
+void ov7670_sim_send_frame(const uint8_t *rgb565);
+
+// bytes of the last frame as they went out on the bus, minus chroma in
+// luma mode, i.e. what should land in the frame slot
+const uint8_t *ov7670_sim_expected(uint32_t *len);
+
+// synthetic RGB565 test frame: dark floor with a bright stripe
+// vertical = 1: stripe of width w centered on column pos, else a row stripe,
+// tilted by slope/16 pixels per pixel about the image center
+void ov7670_sim_synthetic(uint8_t *rgb565, int vertical, int pos, int slope, int w, int noise, uint32_t *seed);
+
+// track pieces along the image columns, 5 rows wide, the near end on column 0
+enum {
+    SIM_STRAIGHT = 0, // on row pos
+    SIM_CURVE,        // bending by (col - 40)^2 / 100 rows
+    SIM_FORK,         // splits at column 40, half a row per column each way
+    SIM_CROSS,        // straight, with a line down column 24
+    SIM_END,          // straight up to column 40
+    SIM_NONE          // floor only
+};
+void ov7670_sim_track(uint8_t *rgb565, int shape, int pos, int noise, uint32_t *seed);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef PICO_HOST_h
+#define PICO_HOST_h
+
+#include "pico/stdlib.h"
+
+// Host-only hooks into pico_stub.c for simulated hardware.
+
+// level of the input pins, what gpio_get_all() returns on the GPIO_IN pins
+void host_gpio_set_inputs(uint32_t value);
+// run the GPIO interrupt callback as if this edge happened, if it is enabled
+void host_gpio_edge(uint gpio, uint32_t event);
+// last value written to a camera register over I2C
+uint8_t host_i2c_register(uint8_t reg);
+// share of the PWM period a pin is high, from the slice's wrap and level
+float host_pwm_duty(uint gpio);
+// run the pin's slice counter through one period: its length and the time
+// the pin is high, in 16ths of a system clock
+void host_pwm_measure(uint gpio, uint32_t *period_16, uint32_t *high_16);
+// one PWM wrap on all running slices: the levels written since the last one
+// take effect, then the wrap interrupt runs if it is armed
+void host_pwm_wrap(void);
+// compare register stores so far, a level or both levels of a slice are one
+uint32_t host_pwm_cc_writes(void);
+// run the counters of the running slices this many counts on, each around
+// its own period, what pwm_get_counter() reads
+void host_pwm_run(uint32_t counts);
+
+#endif
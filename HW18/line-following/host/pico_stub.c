@@ -0,0 +1,261 @@
+// No-op / bookkeeping versions of the pico SDK calls used by the firmware,
+// enough to run the camera and vision code on a desktop.
+#include <stdio.h>
+#include <time.h>
+
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/i2c.h"
+#include "hardware/pwm.h"
+#include "hardware/clocks.h"
+#include "pico_host.h"
+
+int stdio_put_string(const char *s, int len, bool newline, bool cr_translation){
+    (void)cr_translation;
+    fwrite(s, 1, len, stdout);
+    if (newline) fputc('\n', stdout);
+    return len;
+}
+
+void stdio_flush(void){
+    fflush(stdout);
+}
+
+int getchar_timeout_us(uint32_t timeout_us){
+    (void)timeout_us;
+    return PICO_ERROR_TIMEOUT;
+}
+
+// the camera is never really slept on, the replayed frames arrive instantly
+void sleep_ms(uint32_t ms){ (void)ms; }
+void sleep_us(uint64_t us){ (void)us; }
+
+// counts from the first call, like the Pico timer counts from boot
+uint64_t time_us_64(void){
+    static uint64_t boot = 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+    if (boot == 0) boot = now - 1;
+    return now - boot;
+}
+
+uint32_t time_us_32(void){
+    return (uint32_t)time_us_64();
+}
+
+uint32_t clock_get_hz(enum clock_index clk_index){
+    (void)clk_index;
+    return 150000000;
+}
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data, struct repeating_timer *out){
+    out->delay_us = delay_us;
+    out->callback = callback;
+    out->user_data = user_data;
+    return true;
+}
+
+bool cancel_repeating_timer(struct repeating_timer *timer){
+    timer->callback = NULL;
+    return true;
+}
+
+struct alarm_pool{
+    uint maxTimers;
+};
+
+alarm_pool_t *alarm_pool_create_with_unused_hardware_alarm(uint max_timers){
+    static alarm_pool_t pool;
+    pool.maxTimers = max_timers;
+    return &pool;
+}
+
+bool alarm_pool_add_repeating_timer_us(alarm_pool_t *pool, int64_t delay_us, repeating_timer_callback_t callback, void *user_data, struct repeating_timer *out){
+    (void)pool;
+    return add_repeating_timer_us(delay_us, callback, user_data, out);
+}
+
+static uint32_t gpio_out;
+static uint32_t gpio_dir;   // 1 = output
+static uint32_t gpio_in;    // driven by the simulated hardware
+static uint32_t gpio_irq_events[32];
+static gpio_irq_callback_t gpio_irq_callback = NULL;
+
+void gpio_init(uint gpio){
+    gpio_dir &= ~(1u << gpio);
+    gpio_out &= ~(1u << gpio);
+}
+void gpio_set_dir(uint gpio, bool out){
+    if (out) gpio_dir |= 1u << gpio;
+    else gpio_dir &= ~(1u << gpio);
+}
+void gpio_put(uint gpio, bool value){
+    if (value) gpio_out |= 1u << gpio;
+    else gpio_out &= ~(1u << gpio);
+}
+uint32_t gpio_get_all(void){ return (gpio_out & gpio_dir) | (gpio_in & ~gpio_dir); }
+bool gpio_get(uint gpio){ return (gpio_get_all() >> gpio) & 1; }
+void gpio_set_function(uint gpio, enum gpio_function fn){ (void)gpio; (void)fn; }
+void gpio_pull_up(uint gpio){ (void)gpio; }
+// like the SDK there is one callback per core, the event mask is per pin
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback){
+    if (enabled) gpio_irq_events[gpio] |= event_mask;
+    else gpio_irq_events[gpio] &= ~event_mask;
+    gpio_irq_callback = callback;
+}
+
+void host_gpio_set_inputs(uint32_t value){
+    gpio_in = value;
+}
+
+void host_gpio_edge(uint gpio, uint32_t event){
+    if ((gpio_irq_events[gpio] & event) && gpio_irq_callback != NULL){
+        gpio_irq_callback(gpio, event);
+    }
+}
+
+i2c_inst_t *const host_i2c1 = 0;
+
+// SCCB-like register file: a 2 byte write sets a register, a 1 byte write
+// sets the address for the next read. PID/VER read back as a real OV7670.
+static uint8_t i2cRegs[256] = { [0x0a] = 0x76, [0x0b] = 0x73 };
+static uint8_t i2cAddr = 0;
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate){ (void)i2c; return baudrate; }
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop){
+    (void)i2c; (void)addr; (void)nostop;
+    if (len >= 1) i2cAddr = src[0];
+    if (len >= 2) i2cRegs[i2cAddr] = src[1];
+    return (int)len;
+}
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop){
+    (void)i2c; (void)addr; (void)nostop;
+    for (size_t i = 0; i < len; i++) dst[i] = i2cRegs[i2cAddr];
+    return (int)len;
+}
+
+uint8_t host_i2c_register(uint8_t reg){ return i2cRegs[reg]; }
+
+// the slices keep their setup and levels so simulated motors can read them
+// back and host_pwm_measure() can run the counter. Like the hardware the
+// compare values are double buffered: writes go to pwm_cc and the slice
+// takes them at its wrap, host_pwm_wrap(). All running slices wrap together,
+// as they do with the same profile enabled at once. The counters themselves
+// only move in host_pwm_run(), kept as the count into the period.
+static uint16_t pwm_wrap[8];
+static uint16_t pwm_div_16[8];
+static bool pwm_phase_correct[8];
+static uint16_t pwm_cc[8][2];
+static uint16_t pwm_level[8][2];
+static uint32_t pwm_ctr[8];
+static uint32_t pwm_inte;
+static uint32_t pwm_intr;
+static uint32_t pwm_cc_writes;
+pwm_hw_t host_pwm_hw;
+
+static irq_handler_t irq_handlers[32];
+static uint32_t irq_enabled;
+
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority){
+    (void)order_priority;
+    irq_handlers[num] = handler;
+}
+void irq_set_enabled(uint num, bool enabled){
+    if (enabled) irq_enabled |= 1u << num;
+    else irq_enabled &= ~(1u << num);
+}
+
+uint pwm_gpio_to_slice_num(uint gpio){ return (gpio >> 1) & 7; }
+uint pwm_gpio_to_channel(uint gpio){ return gpio & 1; }
+void pwm_set_clkdiv(uint slice_num, float divider){ pwm_div_16[slice_num] = (uint16_t)(divider * 16); }
+void pwm_set_clkdiv_int_frac(uint slice_num, uint8_t integer, uint8_t fract){ pwm_div_16[slice_num] = (uint16_t)(integer * 16 + (fract & 0xF)); }
+void pwm_set_wrap(uint slice_num, uint16_t wrap){ pwm_wrap[slice_num] = wrap; }
+void pwm_set_phase_correct(uint slice_num, bool phase_correct){ pwm_phase_correct[slice_num] = phase_correct; }
+void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level){
+    pwm_cc[slice_num][chan] = level;
+    pwm_cc_writes++;
+}
+void pwm_set_both_levels(uint slice_num, uint16_t level_a, uint16_t level_b){
+    pwm_cc[slice_num][0] = level_a;
+    pwm_cc[slice_num][1] = level_b;
+    pwm_cc_writes++;
+}
+void pwm_set_gpio_level(uint gpio, uint16_t level){ pwm_set_chan_level(pwm_gpio_to_slice_num(gpio), pwm_gpio_to_channel(gpio), level); }
+void pwm_set_enabled(uint slice_num, bool enabled){
+    if (enabled) host_pwm_hw.en |= 1u << slice_num;
+    else host_pwm_hw.en &= ~(1u << slice_num);
+}
+void pwm_set_mask_enabled(uint32_t mask){ host_pwm_hw.en = mask; }
+void pwm_set_counter(uint slice_num, uint16_t c){ pwm_ctr[slice_num] = c; }
+// on the way down a phase correct count reads back from the top
+uint16_t pwm_get_counter(uint slice_num){
+    uint32_t c = pwm_ctr[slice_num];
+    if (c > pwm_wrap[slice_num]) c = 2u * pwm_wrap[slice_num] + 1 - c;
+    return (uint16_t)c;
+}
+void pwm_set_irq_enabled(uint slice_num, bool enabled){
+    if (enabled) pwm_inte |= 1u << slice_num;
+    else pwm_inte &= ~(1u << slice_num);
+}
+void pwm_clear_irq(uint slice_num){ pwm_intr &= ~(1u << slice_num); }
+uint32_t pwm_get_irq_status_mask(void){ return pwm_intr & pwm_inte; }
+
+void host_pwm_wrap(void){
+    uint slice;
+    for(slice=0;slice<8;slice++){
+        if (host_pwm_hw.en & (1u << slice)){
+            pwm_level[slice][0] = pwm_cc[slice][0];
+            pwm_level[slice][1] = pwm_cc[slice][1];
+        }
+    }
+    pwm_intr |= host_pwm_hw.en;
+    if (pwm_get_irq_status_mask() && (irq_enabled & (1u << PWM_IRQ_WRAP)) && irq_handlers[PWM_IRQ_WRAP] != NULL){
+        irq_handlers[PWM_IRQ_WRAP]();
+    }
+}
+
+uint32_t host_pwm_cc_writes(void){ return pwm_cc_writes; }
+
+void host_pwm_run(uint32_t counts){
+    uint slice;
+    for(slice=0;slice<8;slice++){
+        if (host_pwm_hw.en & (1u << slice)){
+            uint32_t period = (pwm_wrap[slice] + 1u) * (pwm_phase_correct[slice] ? 2 : 1);
+            pwm_ctr[slice] = (uint32_t)(((uint64_t)pwm_ctr[slice] + counts) % period);
+        }
+    }
+}
+
+float host_pwm_duty(uint gpio){
+    uint slice = pwm_gpio_to_slice_num(gpio);
+    uint16_t level = pwm_level[slice][pwm_gpio_to_channel(gpio)];
+    if (level > pwm_wrap[slice]) return 1.0f;
+    return (float)level / (pwm_wrap[slice] + 1);
+}
+
+// The counter as the datasheet has it: one count per divider period, up
+// from 0 to wrap and back to 0 (phase correct) or up and wrapping to 0, the
+// pin high while the count is below the level.
+void host_pwm_measure(uint gpio, uint32_t *period_16, uint32_t *high_16){
+    uint slice = pwm_gpio_to_slice_num(gpio);
+    uint32_t level = pwm_level[slice][pwm_gpio_to_channel(gpio)];
+    uint32_t wrap = pwm_wrap[slice];
+    uint32_t counts = 0, high = 0;
+    uint32_t c = 0;
+    int down = 0;
+    do {
+        if (c < level) high++;
+        counts++;
+        if (pwm_phase_correct[slice]){
+            // top and bottom are held for one count on the way round
+            if (!down && c == wrap) down = 1;
+            else if (down && c == 0) down = 0;
+            else c = down ? c - 1 : c + 1;
+        } else {
+            c = c == wrap ? 0 : c + 1;
+        }
+    } while (c != 0 || down); // back where the period started
+    *period_16 = counts * pwm_div_16[slice];
+    *high_16 = high * pwm_div_16[slice];
+}
@@ -0,0 +1,199 @@
+// Runs pwm_profile.c's profiles through the slice counter model in
+// pico_stub.c (host_pwm_measure): the period comes out at the frequency
+// asked for, the high time follows the Q15 duty to within one level and
+// never steps back, 0 and full are flat, and the motor profile gives at
+// least 10 bits above hearing. Motor updates land at a wrap, both motors
+// and the LEDs together, one compare register store per slice, and setting
+// the profile again brings counters that drifted apart back in step.
+//   pwm_sim          exits 1 if anything is off
+#include <stdio.h>
+#include <math.h>
+
+#include "pico_host.h"
+#include "hardware/pwm.h"
+#include "motor_control.h"
+#include "pwm_profile.h"
+
+#define TEST_GPIO AIN1
+
+// high share of the period at duty, checked against the duty, 1 if right
+static int checkDuty(const pwm_profile_t *p, uint32_t duty, uint32_t *lastHigh){
+    uint slice = pwm_gpio_to_slice_num(TEST_GPIO);
+    pwm_set_chan_level(slice, pwm_gpio_to_channel(TEST_GPIO), pwm_profile_level(p, duty));
+    host_pwm_wrap();
+    uint32_t period, high;
+    host_pwm_measure(TEST_GPIO, &period, &high);
+    // high/period against duty/32768 within one level, in integers: float
+    // runs out of digits at 16 bit wraps
+    int64_t off = (int64_t)high * 32768 - (int64_t)duty * period;
+    int64_t level = (int64_t)period * 32768 / (p->wrap + 1);
+    int ok = off <= level && -off <= level && high >= *lastHigh;
+    if (duty == 0) ok = ok && high == 0;
+    if (duty == MOTOR_DUTY_ONE) ok = ok && high == period;
+    *lastHigh = high;
+    return ok;
+}
+
+// motor A in and out, motor B, the two LEDs
+static void readOutputs(float *duty){
+    uint pins[6] = {AIN2, AIN1, BIN1, BIN2, LED_LEFT, LED_RIGHT};
+    int i;
+    for(i=0;i<6;i++){
+        duty[i] = host_pwm_duty(pins[i]);
+    }
+}
+
+static int checkProfile(uint32_t sysHz, uint32_t freq, int bits, bool phaseCorrect){
+    pwm_profile_t p;
+    if (!pwm_profile_make(&p, sysHz, freq, bits, phaseCorrect)){
+        printf("%lu Hz %d bits%s off %lu MHz: no profile\n", (unsigned long)freq, bits,
+            phaseCorrect ? " phase correct" : "", (unsigned long)(sysHz / 1000000));
+        return 1;
+    }
+    uint slice = pwm_gpio_to_slice_num(TEST_GPIO);
+    pwm_profile_apply(&p, slice);
+    pwm_set_enabled(slice, true);
+
+    uint32_t period, high;
+    pwm_set_chan_level(slice, pwm_gpio_to_channel(TEST_GPIO), 0);
+    host_pwm_wrap();
+    host_pwm_measure(TEST_GPIO, &period, &high);
+    float measured = (float)sysHz * 16 / period;
+    int bad = 0;
+    // the divider works in 16ths: within a percent, or within half a 16th of
+    // the divider when fixed bits leave it small
+    float step = freq * 0.5f / p.div_16;
+    if (fabsf(measured - freq) > (step > freq * 0.01f ? step : freq * 0.01f) || fabsf(measured - p.freq_hz) > 1.0f){
+        bad++;
+    }
+    if (bits != 0 && p.bits != bits){
+        bad++;
+    }
+    uint32_t lastHigh = 0, duty;
+    int wrong = 0;
+    for(duty=0;duty<MOTOR_DUTY_ONE;duty+=97){
+        wrong = wrong + !checkDuty(&p, duty, &lastHigh);
+    }
+    wrong = wrong + !checkDuty(&p, MOTOR_DUTY_ONE, &lastHigh);
+    if (wrong){
+        bad++;
+    }
+    printf("%3lu MHz %6lu Hz%s%s: div %u.%02u wrap %5u, %2u bits, %.1f Hz measured, %d duties off\n",
+        (unsigned long)(sysHz / 1000000), (unsigned long)freq, phaseCorrect ? " phase correct" : "              ",
+        bits ? " fixed bits" : "           ", p.div_16 >> 4, (p.div_16 & 15) * 100 / 16, p.wrap, p.bits, measured, wrong);
+    return bad;
+}
+
+int main(){
+    int bad = 0;
+
+    uint32_t clocks[] = {125000000, 150000000};
+    uint32_t freqs[] = {1000, 10000, 20000, 25000, 40000};
+    int c, f, pc;
+    for(c=0;c<2;c++){
+        for(f=0;f<5;f++){
+            for(pc=0;pc<2;pc++){
+                bad = bad + checkProfile(clocks[c], freqs[f], 0, pc);
+                bad = bad + checkProfile(clocks[c], freqs[f], 10, pc);
+            }
+        }
+    }
+
+    // what the divider can't reach
+    pwm_profile_t p;
+    if (pwm_profile_make(&p, 150000000, 1, 0, false) || pwm_profile_make(&p, 150000000, 40000, 16, true)){
+        printf("made a profile out of range\n");
+        bad++;
+    }
+
+    // the motors: ultrasonic with 10 bits or more, the same duty steps through
+    // motor_a_set_q15() to the pin
+    motor_init();
+    const pwm_profile_t *m = motor_pwm_profile();
+    printf("motors: %lu Hz, %u bits%s\n", (unsigned long)m->freq_hz, m->bits, m->phase_correct ? ", phase correct" : "");
+    if (m->freq_hz < 20000 || m->bits < 10){
+        printf("audible or coarse\n");
+        bad++;
+    }
+    uint32_t lastHigh = 0, steps = 0;
+    int32_t duty;
+    for(duty=0;duty<=MOTOR_DUTY_ONE;duty+=8){
+        motor_b_set_q15(duty);
+        host_pwm_wrap();
+        host_pwm_wrap();
+        uint32_t period, high;
+        host_pwm_measure(BIN1, &period, &high);
+        if (high < lastHigh){
+            bad++;
+        }
+        steps = steps + (high != lastHigh);
+        lastHigh = high;
+    }
+    printf("motor B: %lu distinct duties from 0 to full\n", (unsigned long)steps + 1);
+    if (steps + 1 < 1024){
+        printf("fewer than 10 bits reach the pin\n");
+        bad++;
+    }
+
+    // a change of direction on both motors: nothing moves until the wrap
+    // after the interrupt, then all six outputs at once, one compare store
+    // per slice, and a motor never has both inputs on
+    motor_set_q15(MOTOR_DUTY_ONE * 3 / 4, MOTOR_DUTY_ONE * 3 / 4);
+    host_pwm_wrap();
+    host_pwm_wrap();
+    float before[6], after[6];
+    readOutputs(before);
+    uint32_t writes = host_pwm_cc_writes();
+    motor_set_q15(-MOTOR_DUTY_ONE * 3 / 4, -MOTOR_DUTY_ONE * 3 / 4);
+    int changed[3];
+    int w;
+    for(w=0;w<3;w++){
+        readOutputs(after);
+        changed[w] = 0;
+        int i;
+        for(i=0;i<6;i++){
+            changed[w] = changed[w] + (after[i] != before[i]);
+        }
+        if ((after[0] > 0 && after[1] > 0) || (after[2] > 0 && after[3] > 0)){
+            printf("both inputs of a motor on\n");
+            bad++;
+        }
+        host_pwm_wrap();
+    }
+    writes = host_pwm_cc_writes() - writes;
+    printf("reversing: %d %d %d outputs changed at commit, interrupt, wrap; %lu compare stores\n",
+        changed[0], changed[1], changed[2], (unsigned long)writes);
+    // the LEDs go by the size of the duty, they stay
+    if (changed[0] != 0 || changed[1] != 0 || changed[2] != 4 || writes != 4){
+        printf("not together at the wrap\n");
+        bad++;
+    }
+
+    // counters apart: run, stop motor B's slice a while, run again. Setting
+    // the profile once more has to start them all from 0 together
+    uint slices[4] = {pwm_gpio_to_slice_num(AIN1), pwm_gpio_to_slice_num(BIN1),
+        pwm_gpio_to_slice_num(LED_LEFT), pwm_gpio_to_slice_num(LED_RIGHT)};
+    host_pwm_run(12345);
+    pwm_set_enabled(slices[1], false);
+    host_pwm_run(m->wrap / 3 + 1);
+    pwm_set_enabled(slices[1], true);
+    host_pwm_run(777);
+    int apart = 0, s;
+    for(s=1;s<4;s++){
+        apart = apart + (pwm_get_counter(slices[s]) != pwm_get_counter(slices[0]));
+    }
+    motor_init_profile(m);
+    host_pwm_run(4321);
+    int stepped = 0;
+    for(s=1;s<4;s++){
+        stepped = stepped + (pwm_get_counter(slices[s]) != pwm_get_counter(slices[0]));
+    }
+    printf("profile again: %d slices apart before, %d after\n", apart, stepped);
+    if (apart == 0 || stepped != 0){
+        printf("counters not back in step\n");
+        bad++;
+    }
+
+    printf("%d bad\n", bad);
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,160 @@
+// Runs the wheel speed loop in motor_control.c against host/motor_sim.c at
+// CONTROL_HZ: step responses on a full and a flat battery, a weak motor, a
+// battery draining under way, a command the feed forward under-drives and
+// one the motors can't reach.
+//   speed_sim        exits 1 if anything is off
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "motor_control.h"
+#include "encoder.h"
+#include "control.h"
+#include "motor_sim.h"
+
+#define SIM_STEP_US 500
+
+typedef struct result{
+    float rise;      // s to 90% of the step
+    float maxError;  // mm/s, wheel against the target after settleUs
+    float estRms;    // mm/s, estimate against the wheel
+    float maxIntegral;
+    int saturated;   // updates a wheel spent at full duty
+    float windup;    // most the integral grew towards the saturated side in one of them
+    float integral;  // the left wheel's at the end
+} result_t;
+
+// drive both wheels at target mm/s for us microseconds, the battery going
+// from volts to endVolts on the way
+static result_t run(int target, float volts, float endVolts, float weakLeft, uint32_t us, uint32_t settleUs){
+    motor_init();
+    motorSimReset(volts);
+    motorSimSetFactor(ENCODER_LEFT, weakLeft);
+    motor_speed_init();
+    motor_speed_set(target, target);
+    result_t res = {-1, 0, 0, 0, 0, 0, 0};
+    float last[2] = {0, 0};
+    float estSum = 0;
+    int estCount = 0;
+    uint32_t now;
+    for(now=0;now<us;now+=SIM_STEP_US){
+        motorSimSetBattery(volts + (endVolts - volts) * now / us);
+        if (now % CONTROL_PERIOD_US == 0){
+            motor_speed_update(CONTROL_PERIOD_US);
+            wheel_speed_t w[2];
+            motor_speed_get(&w[ENCODER_LEFT], &w[ENCODER_RIGHT]);
+            int i;
+            for(i=0;i<2;i++){
+                float e = REAL_TO_FLOAT(w[i].speed) - motorSimSpeed(i);
+                estSum = estSum + e*e;
+                estCount++;
+                float integral = REAL_TO_FLOAT(w[i].integral);
+                if (fabsf(integral) > res.maxIntegral) res.maxIntegral = fabsf(integral);
+                if (abs(w[i].duty) >= MOTOR_DUTY_ONE){
+                    float grew = w[i].duty > 0 ? integral - last[i] : last[i] - integral;
+                    if (grew > res.windup) res.windup = grew;
+                    res.saturated++;
+                }
+                last[i] = integral;
+            }
+            res.integral = last[ENCODER_LEFT];
+        }
+        motorSimStep(SIM_STEP_US * 1e-6f);
+        int i;
+        for(i=0;i<2;i++){
+            float v = motorSimSpeed(i);
+            if (res.rise < 0 && i == ENCODER_LEFT && fabsf(v) >= 0.9f * abs(target)){
+                res.rise = now * 1e-6f;
+            }
+            if (now >= settleUs && fabsf(v - target) > res.maxError){
+                res.maxError = fabsf(v - target);
+            }
+        }
+    }
+    res.estRms = sqrtf(estSum / estCount);
+    return res;
+}
+
+int main(){
+    int bad = 0;
+
+    // the same command is the same speed, full or flat
+    float batteries[] = {8.4f, 6.8f};
+    int i;
+    for(i=0;i<2;i++){
+        result_t res = run(200, batteries[i], batteries[i], 1.0f, 1000000, 300000);
+        printf("200 mm/s at %.1f V: 90%% in %.0f ms, off by at most %.1f mm/s after 300 ms, estimate rms %.1f mm/s\n",
+            batteries[i], res.rise * 1000, res.maxError, res.estRms);
+        if (res.rise < 0 || res.rise > 0.15f || res.maxError > 10 || res.estRms > 10){
+            printf("slow or off\n");
+            bad++;
+        }
+    }
+
+    // backwards too
+    result_t back = run(-150, 7.4f, 7.4f, 1.0f, 1000000, 300000);
+    printf("-150 mm/s: 90%% in %.0f ms, off by at most %.1f mm/s after 300 ms\n", back.rise * 1000, back.maxError);
+    if (back.rise < 0 || back.maxError > 10){
+        printf("doesn't reverse\n");
+        bad++;
+    }
+
+    // a 20% weaker left motor still does what the right one does
+    result_t weak = run(200, 7.4f, 7.4f, 0.8f, 1000000, 300000);
+    printf("20%% weaker left motor: off by at most %.1f mm/s after 300 ms\n", weak.maxError);
+    if (weak.maxError > 10){
+        printf("the weak motor lags\n");
+        bad++;
+    }
+
+    // the battery going flat under way
+    result_t drain = run(250, 8.4f, 6.8f, 1.0f, 3000000, 300000);
+    printf("250 mm/s draining 8.4 to 6.8 V: off by at most %.1f mm/s\n", drain.maxError);
+    if (drain.maxError > 10){
+        printf("follows the battery down\n");
+        bad++;
+    }
+
+    // a 30% weaker left motor on a flat battery: 210 mm/s is in reach at
+    // about 98% duty but the feed forward gives 72%, so the integral has to
+    // make up the rest, and on the way up the wheel is flat out without it
+    // growing any further
+    result_t under = run(210, 6.8f, 6.8f, 0.7f, 1000000, 400000);
+    printf("210 mm/s, 30%% weaker left motor at 6.8 V: off by at most %.1f mm/s after 400 ms, integral %.2f, "
+        "up to %.2f, grew %.4f in %d updates at full duty\n",
+        under.maxError, under.integral, under.maxIntegral, under.windup, under.saturated);
+    if (under.saturated == 0 || under.integral < 0.15f || under.maxError > 10 ||
+        under.maxIntegral > REAL_TO_FLOAT(SPEED_I_MAX) + 0.001f || under.windup > 0.001f){
+        printf("winds up\n");
+        bad++;
+    }
+
+    // more than the motors can do: flat out all the way, the same
+    result_t flat = run(SPEED_MAX, 6.8f, 6.8f, 1.0f, 1000000, 1000000);
+    printf("%d mm/s at 6.8 V: integral up to %.2f of full duty, grew %.4f in %d updates at full duty\n",
+        SPEED_MAX, flat.maxIntegral, flat.windup, flat.saturated);
+    if (flat.saturated == 0 || flat.maxIntegral > REAL_TO_FLOAT(SPEED_I_MAX) + 0.001f || flat.windup > 0.001f){
+        printf("winds up\n");
+        bad++;
+    }
+    // and comes straight back from there
+    motor_speed_set(150, 150);
+    uint32_t now, settled = 0;
+    for(now=0;now<1000000;now+=SIM_STEP_US){
+        if (now % CONTROL_PERIOD_US == 0){
+            motor_speed_update(CONTROL_PERIOD_US);
+        }
+        motorSimStep(SIM_STEP_US * 1e-6f);
+        if (fabsf(motorSimSpeed(ENCODER_LEFT) - 150) > 10){
+            settled = now;
+        }
+    }
+    printf("back down to 150 mm/s in %lu ms\n", (unsigned long)(settled / 1000));
+    if (settled > 300000){
+        printf("slow out of saturation\n");
+        bad++;
+    }
+
+    printf("%d bad\n", bad);
+    return bad ? 1 : 0;
+}
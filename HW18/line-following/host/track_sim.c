@@ -0,0 +1,101 @@
+// Feeds tracker.c fits of a simulated line moving across the image and
+// checks the prediction, the coasting through missing frames and the gate.
+//   track_sim        exits 1 if anything is off
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "tracker.h"
+
+#define FRAME_US 33333  // 30 fps
+#define LATENCY_US 5000 // frame to motors
+
+static uint32_t seed = 1;
+
+// line position in rows at time us: a slow sweep across the image
+static float truth(uint32_t us){
+    return 30.0f + 15.0f*sinf(us * 1e-6f);
+}
+
+static lineFit_t measure(uint32_t us){
+    lineFit_t fit;
+    seed = seed*1103515245 + 12345;
+    float noise = ((int)((seed >> 16) % 101) - 50) / 100.0f; // +-0.5 row
+    fit.offset = (real_t)((truth(us) + noise) * REAL_ONE);
+    fit.heading = 0;
+    fit.slope = 0;
+    fit.quality = 80;
+    fit.points = CAM_FIT_LINES;
+    return fit;
+}
+
+int main(){
+    lineTrack_t t;
+    trackReset(&t);
+    int bad = 0;
+    uint32_t us = 1000;
+    int i;
+
+    // settle, then score the prediction to the time the motors act
+    double sq = 0;
+    int count = 0;
+    for(i=0;i<300;i++, us+=FRAME_US){
+        lineFit_t fit = measure(us);
+        trackUpdate(&t, &fit, us);
+        if (i >= 30){
+            float e = REAL_TO_FLOAT(trackPredict(&t, us + LATENCY_US)) - truth(us + LATENCY_US);
+            sq += e*e;
+            count++;
+        }
+    }
+    float rms = sqrtf(sq / count);
+    printf("predict rms %.2f rows\n", rms);
+    if (rms > 0.6f){
+        printf("prediction worse than the measurement noise\n");
+        bad++;
+    }
+
+    // 10 frames without a line: keep following the motion, get less sure
+    real_t lastConf = trackConfidence(&t, t.time);
+    lineFit_t none = {0};
+    for(i=0;i<10;i++, us+=FRAME_US){
+        trackUpdate(&t, &none, us);
+        real_t conf = trackConfidence(&t, us);
+        float e = REAL_TO_FLOAT(trackPredict(&t, us)) - truth(us);
+        if (!t.valid || conf >= lastConf || fabsf(e) > 3){
+            printf("coast %d: valid %d confidence %.2f error %.2f\n", i, t.valid, REAL_TO_FLOAT(conf), e);
+            bad++;
+        }
+        lastConf = conf;
+    }
+    printf("after 10 missed frames confidence %.2f\n", REAL_TO_FLOAT(lastConf));
+
+    // a good fit brings it back
+    lineFit_t fit = measure(us);
+    if (!trackUpdate(&t, &fit, us) || trackConfidence(&t, us) < REAL(0.9)){
+        printf("fit after coasting not taken\n");
+        bad++;
+    }
+    us += FRAME_US;
+
+    // glare 25 rows off is outside the gate
+    fit = measure(us);
+    fit.offset = fit.offset + REAL(25.0);
+    if (trackUpdate(&t, &fit, us)){
+        printf("outlier taken\n");
+        bad++;
+    }
+    us += FRAME_US;
+
+    // a long outage loses the track
+    for(i=0;i<30;i++, us+=FRAME_US){
+        trackUpdate(&t, &none, us);
+    }
+    if (t.valid || trackConfidence(&t, us) != 0){
+        printf("track not lost after 1 s\n");
+        bad++;
+    }
+
+    printf("%d bad\n", bad);
+    return bad ? 1 : 0;
+}
@@ -2,22 +2,70 @@
 #include <stdlib.h>
 
 #include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "pico/mutex.h"
 #include "hardware/pwm.h"
 
 #include "cam.h"
+#include "blob.h"
+#include "tracker.h"
+#include "scanline.h"
+#include "ground.h"
+#include "vision_bench.h"
+#include "frame_stream.h"
+#include "cam_stats.h"
+#include "control.h"
 #include "motor_control.h"
 
-const int MAX_DUTY = 100;
-const int MIN_DUTY = 60;
-const int BASE_DUTY = 65;
-const int DEADBAND = 5;
-const float GAIN = 0.9f;
-const int LEFT_BIAS = 2;
-const float LEFT_BIAS_SLOPE = 1.2;
+// speeds, gains and the control rate are in control.h, the wheel speed
+// loop in motor_control.h
+const int MIN_FIT_QUALITY = 40;   // below this only the offset is used
+const int FORK_BRANCH = BRANCH_LOW; // side to take at a fork
+// while the track is this sure only a window around the prediction is
+// scanned, with a full scan every FULL_SCAN_EVERY frames to see forks,
+// crossings and the end of the line coming
+const real_t SPARSE_CONFIDENCE = REAL(0.7);
+const int FULL_SCAN_EVERY = 8;
+
+// which way to go where the track splits or crosses another line
+static int forkPolicy(const frameTopology_t *topo) {
+    if (topo->type == TOPO_FORK) {
+        return FORK_BRANCH;
+    }
+    return BRANCH_NEAREST; // straight over crossings
+}
+const branchPolicy_t BRANCH_POLICY = forkPolicy;
+
+// Core 0 captures and finds the line, core 1 steers and prints. The frame
+// packets and the telemetry share the USB serial, whoever holds console
+// writes; core 1 skips a telemetry line rather than wait for it.
+auto_init_mutex(console);
+
+// core 1: the control ticks on its own alarm, telemetry in between
+static void core1Main(void) {
+    controlStart();
+    uint32_t printed = 0; // estimate the last telemetry line was for
+    while (true) {
+        // what the control tick did last, once per frame
+        controlStatus_t steer;
+        controlGetStatus(&steer);
+        if (steer.seq != printed && mutex_try_enter(&console, NULL)) {
+            uint32_t t0 = time_us_32();
+            printf("%d %d %d %s\r\n", REAL_TO_INT(steer.error), REAL_TO_INT(REAL_MUL(steer.slope, REAL(1000))),
+                REAL_TO_INT(REAL_MUL(steer.confidence, REAL(100))), topologyNames[steer.topology]);
+            mutex_exit(&console);
+            printed = steer.seq;
+            camStatsBusy(time_us_32() - t0);
+        }
+        tight_loop_contents();
+    }
+}
 
 int main() {
     stdio_init_all();
+    camStatsInit();
     motor_init();
+    motor_speed_init();
 
     // while (!stdio_usb_connected()) {
     //     sleep_ms(100);
@@ -26,36 +74,86 @@ int main() {
     //printf("Time to follow the line!\n");
     init_camera_pins();
     sleep_ms(20);
+
+    // the camera keeps capturing into the frame ring while we process
+    startFrameStream();
+    // the line across frames, predicts through frames without a line
+    lineTrack_t lineTrack;
+    trackReset(&lineTrack);
+    // steers from the newest line estimate at CONTROL_HZ, on core 1
+    controlReset();
+    multicore_launch_core1(core1Main);
+    frameTopology_t topo; // segments on the scanlines of the last full scan
+    topo.type = TOPO_NONE;
+    real_t trackSlope = 0; // rows per column of the last fit the tracker took
+    real_t trackCurvature = 0; // and how it bent
+    int sparseFrames = 0;  // frames since the last full scan
  
     while (true) {
-        setSaveImage(1);
-        while(getSaveImage()==1) {}
-        convertImage();
-
-        int com = findLineColumn(IMAGESIZEX/2);
-        setPixel(IMAGESIZEX/2, com, 0, 255, 0);
-
-        int image_center = IMAGESIZEX / 2;
-        int error = com - image_center;
-        printf("%d\r\n", error);
-
-        if (abs(error) < DEADBAND) {
-            motor_a_set(BASE_DUTY);
-            motor_b_set(BASE_DUTY);
+        cameraFrame_t *frame = acquireFrame();
+        if (frame == NULL) {
+            tight_loop_contents();
+            continue;
+        }
+        uint32_t t0 = time_us_32();
+        // a plain line where the tracker expects it only needs the window
+        // around it, anything else falls back to the full scan
+        lineFit_t fit;
+        real_t trackRow = lineTrack.valid ? trackPredict(&lineTrack, frame->timestamp) : REAL_FROM_INT(-1);
+        int sparse = lineTrack.valid && sparseFrames < FULL_SCAN_EVERY
+            && (topo.type == TOPO_STRAIGHT || topo.type == TOPO_CURVE)
+            && trackConfidence(&lineTrack, frame->timestamp) >= SPARSE_CONFIDENCE
+            && fitLineNear(&fit, trackRow, trackSlope, trackCurvature) > 0;
+        if (sparse) {
+            sparseFrames++;
         } else {
-            int adjust = (int)(GAIN * error);
-
-            int left_duty  = BASE_DUTY + adjust + LEFT_BIAS;
-            int right_duty = BASE_DUTY - adjust;
+            sparseFrames = 0;
+            // follow the blob that continues last frame's line, so glare or
+            // a second line next to it doesn't pull the fit over
+            // at forks and crossings the line is one blob with branches, so
+            // the policy picks a branch from the scanline segments instead
+            analyzeTopology(frame, &topo);
+            if (topo.type == TOPO_FORK || topo.type == TOPO_CROSS) {
+                followBranch(&topo, BRANCH_POLICY(&topo), trackRow, &fit);
+            } else {
+                const blob_t *track = pickTrackBlob(findBlobs(frame), trackRow);
+                if (track != NULL) {
+                    blobFitLine(track, &fit);
+                } else {
+                    fitLine(&fit);
+                }
+            }
+        }
+        if (trackUpdate(&lineTrack, &fit, frame->timestamp)) {
+            trackSlope = fit.slope;
+            trackCurvature = fit.curvature;
+        }
+        camStatsRecord(STAT_DETECT, time_us_32() - t0);
 
-            if (left_duty > MAX_DUTY) left_duty = MAX_DUTY;
-            if (left_duty < MIN_DUTY) left_duty = MIN_DUTY;
-            if (right_duty > MAX_DUTY) right_duty = MAX_DUTY;
-            if (right_duty < MIN_DUTY) right_duty = MIN_DUTY;
+        // the heading says where the line goes next, trust it only on a clean fit
+        groundLine_t ground;
+        groundFromFit(&fit, &ground);
+        real_t slope = (lineTrack.misses == 0 && fit.quality >= MIN_FIT_QUALITY) ? ground.slope : 0;
+        controlPublish(&lineTrack, slope, topo.type);
+        camStatsRecord(STAT_LATENCY, time_us_32() - frame->timestamp);
 
-            motor_a_set(left_duty);
-            motor_b_set(right_duty);
+        // python/camera.py asks for frames with single letter commands
+        mutex_enter_blocking(&console);
+        int c = getchar_timeout_us(0);
+        if (c == 'x') {
+            // every vision kernel on this frame, in clock cycles
+            static visionBench_t bench;
+            benchReset(&bench);
+            benchFrame(&bench, frame, 20);
+            benchPrint(&bench, "frame");
+        } else if (c != PICO_ERROR_TIMEOUT) {
+            if (!streamCommand(c)) {
+                camStatsCommand(c);
+            }
         }
+        streamFrame(frame);
+        mutex_exit(&console);
+        releaseFrame(frame);
+        camStatsBusy(time_us_32() - t0);
     }
 }
-
@@ -0,0 +1,47 @@
+#ifndef MAILBOX_h
+#define MAILBOX_h
+
+#include <stdint.h>
+#include <string.h>
+#include "hardware/sync.h"
+
+// Latest-value mailbox from one core to the other, one writer and one
+// reader. seq counts up by 2 per post and is odd while the writer is in
+// the middle of one. Neither side ever waits: the writer just writes, and a
+// reader whose copy overlapped a post gets 0 and keeps what it had, the
+// next try (next control tick) gets the new one. No FIFO, no spinlock.
+
+typedef struct mailbox{
+    volatile uint32_t seq;
+} mailbox_t;
+
+static inline void mailboxReset(mailbox_t *m){
+    m->seq = 0;
+}
+
+// writer side: copy size bytes of data into slot
+static inline void mailboxPost(mailbox_t *m, void *slot, const void *data, size_t size){
+    m->seq = m->seq + 1;
+    __dmb(); // the odd seq is out before the slot changes
+    memcpy(slot, data, size);
+    __dmb(); // the slot is complete before the even seq is out
+    m->seq = m->seq + 1;
+}
+
+// reader side: copy the slot into data, returns the number of posts so far,
+// 0 if nothing was posted yet or the copy overlapped a post
+static inline uint32_t mailboxTake(const mailbox_t *m, const void *slot, void *data, size_t size){
+    uint32_t seq = m->seq;
+    if (seq == 0 || (seq & 1)){
+        return 0;
+    }
+    __dmb();
+    memcpy(data, slot, size);
+    __dmb();
+    if (m->seq != seq){
+        return 0;
+    }
+    return seq / 2;
+}
+
+#endif
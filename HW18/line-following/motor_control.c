@@ -2,88 +2,239 @@
 #include <stdlib.h>
 
 #include "hardware/pwm.h"
+#include "hardware/irq.h"
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
 #include "pico/stdlib.h"
 
 #include "motor_control.h"
+#include "encoder.h"
 
-#define AIN1 16
-#define AIN2 17
-#define BIN1 18
-#define BIN2 19
-#define LED_LEFT 28   // For motor A
-#define LED_RIGHT 21  // For motor B
-
-#define WRAP_VALUE 99
-#define CLOCK_DIV 150.0f
+static pwm_profile_t profile;
 
 static int duty_a = 0;
 static int duty_b = 0;
 
+// Where each output sits, worked out once in motor_init: a slice's compare
+// register holds channel A in its low half and B in its high half. The two
+// inputs of a motor share a slice, so one store sets both and the driver
+// never sees one input changed and the other not.
+typedef struct motor_out {
+    uint8_t slice;
+    uint8_t fwd_shift;  // 0 or 16, the input driven going forward
+    uint8_t rev_shift;  // the one driven going backward
+} motor_out_t;
+
+typedef struct led_out {
+    uint8_t slice;
+    uint8_t shift;
+} led_out_t;
+
+static motor_out_t out_a, out_b;
+static led_out_t out_led_left, out_led_right;
+
+// Compare values are written whole per slice. cc_next is what the setters
+// build up, motor_pwm_commit() copies it to cc_ready and the wrap interrupt
+// of the motor A slice writes cc_ready to the hardware. The slices are
+// enabled together with the same profile, so they wrap together: writes
+// right after one wrap all take effect at the next, motors and LEDs in the
+// same period.
+// The interrupt is enabled on core 0 and the control tick commits from
+// core 1, so cc_seq is odd while a commit is copying and goes up by 2 per
+// commit. The interrupt only writes a copy that had the same even cc_seq
+// before and after, else it stays armed and tries again next wrap.
+static uint32_t cc_next[NUM_PWM_SLICES];
+static volatile uint32_t cc_ready[NUM_PWM_SLICES];
+static volatile uint32_t cc_seq;
+static uint32_t slice_mask;  // slices the motors and LEDs use
+static uint sync_slice;      // the one whose wrap interrupt writes them
+
 static void init_pwm_pin(uint gpio);
-static void set_motor_pwm(uint in1, uint in2, int duty);
-static void set_led_pwm(uint led_gpio, int duty);
+static void stage_motor(const motor_out_t *m, int32_t duty);
+static void stage_led(const led_out_t *l, int32_t duty);
+static void motor_pwm_commit(void);
+
+static void __isr motor_pwm_wrap_handler(void) {
+    if (!(pwm_get_irq_status_mask() & (1u << sync_slice))) {
+        return;
+    }
+    pwm_clear_irq(sync_slice);
+    uint32_t seq = cc_seq;
+    if (seq & 1) {
+        return; // mid commit
+    }
+    __dmb();
+    uint32_t cc[NUM_PWM_SLICES];
+    uint32_t mask = slice_mask;
+    while (mask) {
+        uint slice = __builtin_ctz(mask);
+        mask &= mask - 1;
+        cc[slice] = cc_ready[slice];
+    }
+    __dmb();
+    if (cc_seq != seq) {
+        return; // a commit came in under the copy
+    }
+    mask = slice_mask;
+    while (mask) {
+        uint slice = __builtin_ctz(mask);
+        mask &= mask - 1;
+        pwm_set_both_levels(slice, cc[slice] & 0xFFFF, cc[slice] >> 16);
+    }
+    // once per commit, not every period, unless one came in since the copy
+    // and its arming is what this just undid
+    pwm_set_irq_enabled(sync_slice, false);
+    __dmb();
+    if (cc_seq != seq) {
+        pwm_set_irq_enabled(sync_slice, true);
+    }
+}
 
 void motor_init(void) {
+    pwm_profile_t p;
+    bool ok = pwm_profile_make(&p, clock_get_hz(clk_sys), MOTOR_PWM_FREQ_HZ, MOTOR_PWM_BITS, MOTOR_PWM_PHASE_CORRECT);
+    hard_assert(ok);
+    motor_init_profile(&p);
+}
+
+static motor_out_t map_motor(uint fwd, uint rev) {
+    motor_out_t m = { pwm_gpio_to_slice_num(fwd), pwm_gpio_to_channel(fwd) * 16, pwm_gpio_to_channel(rev) * 16 };
+    hard_assert(pwm_gpio_to_slice_num(rev) == m.slice);
+    return m;
+}
+
+static led_out_t map_led(uint gpio) {
+    led_out_t l = { pwm_gpio_to_slice_num(gpio), pwm_gpio_to_channel(gpio) * 16 };
+    return l;
+}
+
+void motor_init_profile(const pwm_profile_t *p) {
+    static bool handler_added = false;
+    profile = *p;
+    out_a = map_motor(AIN2, AIN1);  // AIN2/AIN1 swapped for reversed mount
+    out_b = map_motor(BIN1, BIN2);
+    out_led_left = map_led(LED_LEFT);
+    out_led_right = map_led(LED_RIGHT);
+    sync_slice = out_a.slice;
+
+    if (handler_added) {
+        pwm_set_irq_enabled(sync_slice, false);
+    }
+    slice_mask = 0;
     init_pwm_pin(AIN1); init_pwm_pin(AIN2);
     init_pwm_pin(BIN1); init_pwm_pin(BIN2);
     init_pwm_pin(LED_LEFT);
     init_pwm_pin(LED_RIGHT);
+    for (uint slice = 0; slice < NUM_PWM_SLICES; slice++) {
+        cc_next[slice] = 0;
+        cc_ready[slice] = 0;
+    }
+    // all at once so the counters run in step, leaving the camera clock on
+    pwm_set_mask_enabled(pwm_hw->en | slice_mask);
+
+    if (!handler_added) {
+        irq_add_shared_handler(PWM_DEFAULT_IRQ_NUM(), motor_pwm_wrap_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(PWM_DEFAULT_IRQ_NUM(), true);
+        handler_added = true;
+    }
+}
+
+const pwm_profile_t *motor_pwm_profile(void) {
+    return &profile;
 }
 
 static void init_pwm_pin(uint gpio) {
     gpio_set_function(gpio, GPIO_FUNC_PWM);
     uint slice = pwm_gpio_to_slice_num(gpio);
-    pwm_set_clkdiv(slice, CLOCK_DIV);
-    pwm_set_wrap(slice, WRAP_VALUE);
-    pwm_set_chan_level(slice, pwm_gpio_to_channel(gpio), 0);
-    pwm_set_enabled(slice, true);
+    pwm_profile_apply(&profile, slice);
+    slice_mask |= 1u << slice;
 }
 
-static void set_motor_pwm(uint in1, uint in2, int duty) {
-    duty = duty > 100 ? 100 : duty;
-    duty = duty < -100 ? -100 : duty;
-
-    uint slice = pwm_gpio_to_slice_num(in1);
-    uint ch1 = pwm_gpio_to_channel(in1);
-    uint ch2 = pwm_gpio_to_channel(in2);
+static void stage_motor(const motor_out_t *m, int32_t duty) {
+    duty = duty > MOTOR_DUTY_ONE ? MOTOR_DUTY_ONE : duty;
+    duty = duty < -MOTOR_DUTY_ONE ? -MOTOR_DUTY_ONE : duty;
 
+    uint32_t cc = cc_next[m->slice] & ~((0xFFFFu << m->fwd_shift) | (0xFFFFu << m->rev_shift));
     if (duty > 0) {
-        pwm_set_chan_level(slice, ch1, duty * WRAP_VALUE / 100);
-        pwm_set_chan_level(slice, ch2, 0);
+        cc |= (uint32_t)pwm_profile_level(&profile, duty) << m->fwd_shift;
     } else if (duty < 0) {
-        pwm_set_chan_level(slice, ch1, 0);
-        pwm_set_chan_level(slice, ch2, -duty * WRAP_VALUE / 100);
-    } else {
-        pwm_set_chan_level(slice, ch1, 0);
-        pwm_set_chan_level(slice, ch2, 0);
+        cc |= (uint32_t)pwm_profile_level(&profile, -duty) << m->rev_shift;
     }
+    cc_next[m->slice] = cc;
 }
 
-static void set_led_pwm(uint led_gpio, int duty) {
-    uint slice = pwm_gpio_to_slice_num(led_gpio);
-    uint channel = pwm_gpio_to_channel(led_gpio);
+static void stage_led(const led_out_t *l, int32_t duty) {
+    int32_t abs_duty = duty < 0 ? -duty : duty;
+    uint32_t brightness = 0;
 
-    int abs_duty = abs(duty);
-    int brightness = 0;
+    const int32_t from = MOTOR_DUTY_ONE * 60 / 100;
+    if (abs_duty >= from) {
+        uint32_t scaled = (uint32_t)(abs_duty - from) * 256 / (MOTOR_DUTY_ONE - from); // Range: 0–256
+        brightness = scaled * scaled / 2;  // Quadratic mapping, Q15
+    }
+
+    uint32_t level = pwm_profile_level(&profile, brightness);
+    cc_next[l->slice] = (cc_next[l->slice] & ~(0xFFFFu << l->shift)) | (level << l->shift);
+}
 
-    if (abs_duty >= 60) {
-        int scaled = abs_duty - 60;           // Range: 0–40
-        brightness = (scaled * scaled * WRAP_VALUE) / (40 * 40);  // Quadratic mapping
+// hand the staged values to the wrap interrupt. The interrupt may run on
+// the other core in the middle of this, cc_seq tells it to leave the copy
+// alone, and it is armed again after the copy, so the next wrap has all of
+// them.
+static void motor_pwm_commit(void) {
+    cc_seq = cc_seq + 1;
+    __dmb();
+    uint32_t mask = slice_mask;
+    while (mask) {
+        uint slice = __builtin_ctz(mask);
+        mask &= mask - 1;
+        cc_ready[slice] = cc_next[slice];
     }
+    __dmb();
+    cc_seq = cc_seq + 1;
+    // a wrap flag left from before would fire now, in the middle of a period
+    pwm_clear_irq(sync_slice);
+    pwm_set_irq_enabled(sync_slice, true);
+}
+
+static void stage_a(int32_t duty) {
+    stage_motor(&out_a, duty);
+    stage_led(&out_led_left, duty);
+}
+
+static void stage_b(int32_t duty) {
+    stage_motor(&out_b, duty);
+    stage_led(&out_led_right, duty);
+}
+
+void motor_set_q15(int32_t duty_a_q15, int32_t duty_b_q15) {
+    duty_a = duty_a_q15 * 100 / MOTOR_DUTY_ONE;
+    duty_b = duty_b_q15 * 100 / MOTOR_DUTY_ONE;
+    stage_a(duty_a_q15);
+    stage_b(duty_b_q15);
+    motor_pwm_commit();
+}
 
-    pwm_set_chan_level(slice, channel, brightness);
+void motor_a_set_q15(int32_t duty) {
+    duty_a = duty * 100 / MOTOR_DUTY_ONE;
+    stage_a(duty);
+    motor_pwm_commit();
+}
+
+void motor_b_set_q15(int32_t duty) {
+    duty_b = duty * 100 / MOTOR_DUTY_ONE;
+    stage_b(duty);
+    motor_pwm_commit();
 }
 
 void motor_a_set(int duty) {
+    motor_a_set_q15(duty * MOTOR_DUTY_ONE / 100);
     duty_a = duty;
-    set_motor_pwm(AIN2, AIN1, duty_a);  // AIN2/AIN1 swapped for reversed mount
-    set_led_pwm(LED_LEFT, duty_a);
 }
 
 void motor_b_set(int duty) {
+    motor_b_set_q15(duty * MOTOR_DUTY_ONE / 100);
     duty_b = duty;
-    set_motor_pwm(BIN1, BIN2, duty_b);
-    set_led_pwm(LED_RIGHT, duty_b);
 }
 
 void motor_a_increment(void) {
@@ -106,9 +257,93 @@ void motor_b_decrement(void) {
     motor_b_set(duty_b);
 }
 
+// per wheel speed loop state
+typedef struct wheel_state {
+    wheel_speed_t out;
+    int dir;          // ENCODER_*_DIR
+    real_t est_error; // count estimate minus the count, in edges
+    real_t rate;      // edges per second
+    void (*stage)(int32_t duty);
+} wheel_state_t;
+
+static wheel_state_t wheels[2];
+
+void motor_speed_init(void) {
+    encoder_init();
+    wheels[ENCODER_LEFT] = (wheel_state_t){ .dir = ENCODER_LEFT_DIR, .stage = stage_a };
+    wheels[ENCODER_RIGHT] = (wheel_state_t){ .dir = ENCODER_RIGHT_DIR, .stage = stage_b };
+    wheels[ENCODER_LEFT].out.count = ENCODER_LEFT_DIR * encoder_count(ENCODER_LEFT);
+    wheels[ENCODER_RIGHT].out.count = ENCODER_RIGHT_DIR * encoder_count(ENCODER_RIGHT);
+}
+
+void motor_speed_set(int left, int right) {
+    left = left > SPEED_MAX ? SPEED_MAX : (left < -SPEED_MAX ? -SPEED_MAX : left);
+    right = right > SPEED_MAX ? SPEED_MAX : (right < -SPEED_MAX ? -SPEED_MAX : right);
+    wheels[ENCODER_LEFT].out.target = REAL_FROM_INT(left);
+    wheels[ENCODER_RIGHT].out.target = REAL_FROM_INT(right);
+}
+
+// duty that gives speed on a nominal battery, the PI does the rest
+static real_t speed_feed_forward(real_t speed) {
+    if (speed == 0) {
+        return 0;
+    }
+    real_t duty = SPEED_FF_STALL + REAL_MUL(SPEED_FF_GAIN, REAL_ABS(speed));
+    return speed > 0 ? duty : -duty;
+}
+
+static void wheel_update(wheel_state_t *w, int32_t count, uint32_t dt_us) {
+    wheel_speed_t *o = &w->out;
+    int32_t moved = count - o->count;
+    o->count = count;
+
+    // alpha-beta on the count like tracker.c on the line: predict how far
+    // the wheel went at the estimated rate, take a share of the miss
+    real_t miss = w->est_error + REAL_SCALE(w->rate, dt_us, 1000000) - REAL_FROM_INT(moved);
+    w->est_error = miss - REAL_MUL(SPEED_ALPHA, miss);
+    w->rate = w->rate - REAL_SCALE(REAL_MUL(SPEED_BETA, miss), 1000000, dt_us);
+    o->speed = REAL_MUL(w->rate, WHEEL_MM_PER_COUNT);
+
+    real_t error = o->target - o->speed;
+    real_t integral = o->integral;
+    if (o->target == 0 && REAL_ABS(o->speed) < REAL(1.0)) {
+        // stopped, let go instead of holding against the integral
+        integral = 0;
+    } else {
+        integral = integral + REAL_SCALE(REAL_MUL(SPEED_KI, error), dt_us, 1000000);
+        if (integral > SPEED_I_MAX) integral = SPEED_I_MAX;
+        if (integral < -SPEED_I_MAX) integral = -SPEED_I_MAX;
+    }
+    real_t pff = speed_feed_forward(o->target) + REAL_MUL(SPEED_KP, error);
+    real_t duty = pff + integral;
+    // anti-windup: at full duty the integral can't help, don't grow it that way
+    if ((duty > REAL_ONE && integral > o->integral) || (duty < -REAL_ONE && integral < o->integral)) {
+        integral = o->integral;
+        duty = pff + integral;
+    }
+    o->integral = integral;
+    duty = duty > REAL_ONE ? REAL_ONE : (duty < -REAL_ONE ? -REAL_ONE : duty);
+    o->duty = REAL_TO_Q15(duty);
+    w->stage(o->duty);
+}
+
+void motor_speed_update(uint32_t dt_us) {
+    if (dt_us == 0) {
+        return;
+    }
+    wheel_update(&wheels[ENCODER_LEFT], ENCODER_LEFT_DIR * encoder_count(ENCODER_LEFT), dt_us);
+    wheel_update(&wheels[ENCODER_RIGHT], ENCODER_RIGHT_DIR * encoder_count(ENCODER_RIGHT), dt_us);
+    // both wheels change in the same PWM period
+    motor_pwm_commit();
+}
+
+void motor_speed_get(wheel_speed_t *left, wheel_speed_t *right) {
+    *left = wheels[ENCODER_LEFT].out;
+    *right = wheels[ENCODER_RIGHT].out;
+}
+
 void motor_stop_all(void) {
-    motor_a_set(0);
-    motor_b_set(0);
+    motor_set_q15(0, 0);
 }
 
 void motor_test_all(void) {
@@ -2,16 +2,75 @@
 #define MOTOR_CONTROL_H
 
 #include <stdint.h>
+#include "fixed_point.h"
+#include "pwm_profile.h"
 
 #define DUTY_MIN -100
 #define DUTY_MAX  100
 
-// Initialize all motor control pins and PWM
+// duty as a signed Q15 fraction, MOTOR_DUTY_ONE is full on
+#define MOTOR_DUTY_ONE 32768
+
+// PWM on the DRV8833 inputs and the LEDs, see pwm_profile.h. 20 kHz is
+// above hearing, phase correct centers the pulses, and at 150 MHz that
+// leaves 3750 levels (11 bits), 3125 at 125 MHz.
+#ifndef MOTOR_PWM_FREQ_HZ
+#define MOTOR_PWM_FREQ_HZ 20000
+#endif
+#ifndef MOTOR_PWM_BITS
+#define MOTOR_PWM_BITS 0 // 0 for as many as the frequency allows
+#endif
+#ifndef MOTOR_PWM_PHASE_CORRECT
+#define MOTOR_PWM_PHASE_CORRECT 1
+#endif
+
+#define AIN1 16
+#define AIN2 17
+#define BIN1 18
+#define BIN2 19
+#define LED_LEFT 28   // For motor A
+#define LED_RIGHT 22  // For motor B, GP20/21 are the left encoder
+
+// Wheel speed control: an encoder on each wheel (encoder.h), an alpha-beta
+// filter on the counts for the speed, and a PI per wheel from speed to duty
+// on top of a feed forward. The same command is the same speed on a full or
+// a flat battery and on the weaker motor.
+// Motor A is the left wheel, motor B the right one.
+#ifndef ENCODER_COUNTS_PER_REV
+#define ENCODER_COUNTS_PER_REV 1400 // 7 pulses x 4 edges x 50:1 gearbox
+#endif
+#ifndef WHEEL_DIAMETER_MM
+#define WHEEL_DIAMETER_MM 42
+#endif
+#define WHEEL_MM_PER_COUNT REAL(3.14159265 * WHEEL_DIAMETER_MM / ENCODER_COUNTS_PER_REV)
+#define ENCODER_LEFT_DIR (-1)   // mounted mirrored, like motor A
+#define ENCODER_RIGHT_DIR 1
+
+#define SPEED_ALPHA REAL(0.7)     // share of the count error taken per update
+#define SPEED_BETA REAL(0.35)     // same for the speed
+#define SPEED_MAX 400             // mm/s, commands are clamped to this
+// the PI works in duty fractions, 1.0 full on
+#define SPEED_FF_STALL REAL(0.3)   // duty the wheels start turning at
+#define SPEED_FF_GAIN REAL(0.002)  // duty per mm/s above that, on a 7.4 V battery
+#define SPEED_KP REAL(0.0015)      // duty per mm/s
+#define SPEED_KI REAL(0.03)        // duty per mm/s second
+#define SPEED_I_MAX REAL(0.4)      // most the integral can add
+
+// Initialize all motor control pins and PWM, with the MOTOR_PWM_* profile
+// or one of your own
 void motor_init(void);
+void motor_init_profile(const pwm_profile_t *profile);
+const pwm_profile_t *motor_pwm_profile(void);
 
 // Set absolute duty (-100 to 100)
 void motor_a_set(int duty);
 void motor_b_set(int duty);
+// same in the PWM's full resolution, -MOTOR_DUTY_ONE .. MOTOR_DUTY_ONE.
+// Each call takes effect at the PWM wrap after the next one, with the LED;
+// motor_set_q15() changes both motors in the same period.
+void motor_a_set_q15(int32_t duty);
+void motor_b_set_q15(int32_t duty);
+void motor_set_q15(int32_t duty_a, int32_t duty_b);
 
 // Increment or decrement duty
 void motor_a_increment(void);
@@ -19,6 +78,22 @@ void motor_a_decrement(void);
 void motor_b_increment(void);
 void motor_b_decrement(void);
 
+// wheel speed control, motor_init() first
+typedef struct wheel_speed{
+    real_t target;    // mm/s asked for, forward positive
+    real_t speed;     // mm/s from the encoder
+    real_t integral;  // duty the PI adds to the feed forward, 1.0 full on
+    int32_t duty;     // last duty given, Q15
+    int32_t count;    // encoder edges, forward positive
+} wheel_speed_t;
+
+void motor_speed_init(void);
+// mm/s for each wheel, the next motor_speed_update() goes there
+void motor_speed_set(int left, int right);
+// read the encoders and run both PIs, dt_us since the last update
+void motor_speed_update(uint32_t dt_us);
+void motor_speed_get(wheel_speed_t *left, wheel_speed_t *right);
+
 // Stop both motors
 void motor_stop_all(void);
 
@@ -312,6 +312,26 @@ static const uint8_t OV7670_rgb[12][2] = {
     {0xff, 0xff},
 };
 
+static const uint8_t OV7670_yuv[][2] = {
+    // Manual output format, YUV422, full 0-255 output range
+    // with TSLB_YLAST from OV7670_init the byte order is U Y V Y
+    {OV7670_REG_COM7, OV7670_COM7_YUV},
+    {OV7670_REG_RGB444, 0},
+    {OV7670_REG_COM1, 0},
+    {OV7670_REG_COM15, OV7670_COM15_R00FF},
+
+    { OV7670_REG_COM9, 0x48 }, /* 32x gain ceiling; 0x8 is reserved bit */
+    { 0x4f, 0x80 },   /* "matrix coefficient 1" */
+    { 0x50, 0x80 },   /* "matrix coefficient 2" */
+    { 0x51, 0 },    /* vb */
+    { 0x52, 0x22 },   /* "matrix coefficient 4" */
+    { 0x53, 0x5e },   /* "matrix coefficient 5" */
+    { 0x54, 0x80 },   /* "matrix coefficient 6" */
+    { OV7670_REG_COM13, OV7670_COM13_GAMMA | OV7670_COM13_UVSAT },
+
+    {0xff, 0xff},
+};
+
 /** Supported sizes (VGA division factor) for OV7670_set_size() */
 typedef enum {
     OV7670_SIZE_DIV1 = 0, ///< 640 x 480
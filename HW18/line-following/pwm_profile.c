@@ -0,0 +1,49 @@
+#include "pico/stdlib.h"
+#include "hardware/pwm.h"
+
+#include "pwm_profile.h"
+
+bool pwm_profile_make(pwm_profile_t *p, uint32_t sys_hz, uint32_t freq_hz, int bits, bool phase_correct){
+    if (freq_hz == 0 || bits < 0 || bits > 15){
+        return false;
+    }
+    // counter ticks per period at a divider of 1, in 16ths
+    uint64_t ticks_16 = (uint64_t)sys_hz * 16 / ((uint64_t)freq_hz * (phase_correct ? 2 : 1));
+    uint32_t div_16;
+    uint32_t top;
+    if (bits == 0){
+        // as many steps as fit in the period, the divider only where it has to
+        div_16 = (uint32_t)((ticks_16 + 65535 * 16 - 1) / (65535 * 16));
+        if (div_16 < 1) div_16 = 1;
+        div_16 = div_16 * 16;
+        top = (uint32_t)((ticks_16 + div_16 / 2) / div_16);
+    } else {
+        top = 1u << bits;
+        div_16 = (uint32_t)((ticks_16 + top / 2) / top);
+    }
+    // full on is a level of top, which has to fit the 16 bit compare
+    if (div_16 < 16 || div_16 > 4095 || top < 2 || top > 65535){
+        return false;
+    }
+    p->wrap = (uint16_t)(top - 1);
+    p->div_16 = (uint16_t)div_16;
+    p->phase_correct = phase_correct;
+    p->freq_hz = (uint32_t)((uint64_t)sys_hz * 16 / ((uint64_t)top * div_16 * (phase_correct ? 2 : 1)));
+    uint8_t b = 0;
+    while (b < 16 && (2u << b) <= top){
+        b++;
+    }
+    p->bits = b;
+    return true;
+}
+
+void pwm_profile_apply(const pwm_profile_t *p, uint slice){
+    pwm_set_enabled(slice, false);
+    pwm_set_clkdiv_int_frac(slice, p->div_16 >> 4, p->div_16 & 0xF);
+    pwm_set_wrap(slice, p->wrap);
+    pwm_set_phase_correct(slice, p->phase_correct);
+    pwm_set_both_levels(slice, 0, 0);
+    // disabling only stops the counter, start it from the bottom so slices
+    // enabled together come up in step
+    pwm_set_counter(slice, 0);
+}
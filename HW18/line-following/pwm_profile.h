@@ -0,0 +1,34 @@
+#ifndef PWM_PROFILE_h
+#define PWM_PROFILE_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/types.h"
+
+// A PWM slice setup worked out from the frequency and resolution wanted:
+// clock divider, wrap and phase correct mode. The slice runs at
+//   f = sys_hz / ((wrap + 1) * (phase_correct + 1) * (div_16 / 16))
+// and a level of 0 .. wrap + 1 is 0 .. 100% on.
+// host/pwm_sim runs profiles through a model of the slice counter.
+
+typedef struct pwm_profile{
+    uint32_t freq_hz;     // what the slice really runs at
+    uint16_t wrap;        // the counter's top
+    uint16_t div_16;      // clock divider in 16ths, 16 .. 4095 (1.0 .. 255.9375)
+    bool phase_correct;   // count up and down, edges centered in the period
+    uint8_t bits;         // duty resolution, log2(wrap + 1) rounded down
+} pwm_profile_t;
+
+// fill in p for freq_hz off a sys_hz clock. bits = 0 takes the finest
+// resolution the frequency allows, else (1 .. 15) the wrap is 2^bits - 1 and the
+// divider sets the frequency. false if the divider can't get there.
+bool pwm_profile_make(pwm_profile_t *p, uint32_t sys_hz, uint32_t freq_hz, int bits, bool phase_correct);
+// set up a slice with p, disabled, the levels and the counter at 0
+void pwm_profile_apply(const pwm_profile_t *p, uint slice);
+// level for a duty as a Q15 fraction (32768 is 100%), 0 .. wrap + 1
+static inline uint16_t pwm_profile_level(const pwm_profile_t *p, uint32_t duty_q15){
+    if (duty_q15 >= 32768) return (uint16_t)(p->wrap + 1);
+    return (uint16_t)((duty_q15 * ((uint32_t)p->wrap + 1)) >> 15);
+}
+
+#endif
@@ -1,40 +1,35 @@
 import pgzrun # pip install pgzero
+import pygame
 
 import serial
-ser = serial.Serial('/dev/tty.usbmodem1101') # the name of your port here
+ser = serial.Serial('/dev/tty.usbmodem1101', timeout=2) # the name of your port here
 print('Opening port: ' + str(ser.name))
 
 import numpy as np
 
+from frame_protocol import read_frame, to_rgb
+
 # Set the window size
 WIDTH = 400
 HEIGHT = 400
-def update():
-    selection_endline = 'c'+'\n'
-     
-    # send the command 
-    ser.write(selection_endline.encode())
+SCALE = 4
+
+# continuous video, XOR delta coded (use 'b' for thresholded binary, 'r' for raw)
+ser.write('d\nv\n'.encode())
+
 def draw():
-    reds = np.zeros((60, 80), dtype=np.uint8)
-    greens = np.zeros((60, 80), dtype=np.uint8)
-    blues = np.zeros((60, 80), dtype=np.uint8)
-    
-    
-    for t in range(4800):
-            dat_str = ser.read_until(b'\n'); 
-            i,r,g,b = list(map(int,dat_str.split())) 
-            row = i//80
-            col = i%80
-            reds[row][col] = r
-            greens[row][col] = g
-            blues[row][col] = b
-    print(i)
-    print(row)
-    print(col)
+    header, pixels = read_frame(ser)
+    if header is None:
+        # nothing coming, ask for a key frame and turn video on again
+        ser.write('k\nv\n'.encode())
+        return
+    rgb = to_rgb(header, pixels)
+    print(str(header['id']) + ' ' + str(header['bytes']) + ' bytes')
 
     screen.fill((0, 0, 0))  # Fill the background with black
-    for x in range(60):
-         for y in range(80):
-              screen.draw.filled_rect(Rect((x, 60-y), (1, 1)), (reds[x][y], greens[x][y], blues[x][y]))
+    # surfarray is x, y so swap rows and columns
+    frame = pygame.surfarray.make_surface(rgb.swapaxes(0, 1))
+    frame = pygame.transform.scale(frame, (header['width']*SCALE, header['height']*SCALE))
+    screen.blit(frame, (0, header['first_row']*SCALE))
 
 pgzrun.go()
@@ -0,0 +1,120 @@
+# Reads the binary frame packets sent by sendFrame() in frame_stream.c
+#
+# packet: 24 byte header, payload, CRC-32 of header + payload (all little endian)
+#   magic 'CAMF', frame id, timestamp (us), width, height, format, first row,
+#   flags, payload bytes
+# the low byte of flags says how the payload is coded, see FRAME_ENC_* in
+# frame_stream.h
+
+import struct
+import zlib
+
+import numpy as np
+
+FRAME_MAGIC = b'CAMF'
+HEADER = struct.Struct('<4sIIHHBBHI')
+
+FORMAT_RGB565 = 0
+FORMAT_Y8 = 1
+FORMAT_BINARY = 2
+
+ENC_RAW = 0
+ENC_BINARY_RLE = 1
+ENC_DELTA_RLE = 2
+FLAG_KEY = 0x0100
+
+# raw bytes of the last delta frame, the reference for the next one
+_prev = None
+
+
+def read_frame(ser):
+    """Wait for the next good frame on the port.
+
+    Returns (header dict, pixels) where pixels is a height x width numpy
+    array: uint16 RGB565, uint8 Y, or uint8 0/255 for binary frames.
+    Any text the robot prints in between (like the line error) is skipped
+    while looking for the magic. Delta frames are skipped until a key frame
+    arrives; send 'k' to ask for one.
+    """
+    global _prev
+    while True:
+        # sync on the magic, one byte at a time
+        window = b''
+        while window != FRAME_MAGIC:
+            b = ser.read(1)
+            if not b:
+                return None, None  # timeout
+            window = (window + b)[-4:]
+
+        rest = ser.read(HEADER.size - 4)
+        if len(rest) != HEADER.size - 4:
+            return None, None
+        raw_header = FRAME_MAGIC + rest
+        magic, frame_id, timestamp, width, height, fmt, first_row, flags, n = HEADER.unpack(raw_header)
+
+        payload = ser.read(n)
+        crc = ser.read(4)
+        if len(payload) != n or len(crc) != 4:
+            return None, None
+        if zlib.crc32(raw_header + payload) != struct.unpack('<I', crc)[0]:
+            print('bad crc on frame ' + str(frame_id))
+            _prev = None  # the next delta would be wrong too
+            continue
+
+        header = {'id': frame_id, 'timestamp': timestamp, 'width': width,
+                  'height': height, 'format': fmt, 'first_row': first_row,
+                  'flags': flags, 'bytes': n}
+        pixels = decode_payload(header, payload)
+        if pixels is None:
+            continue
+        return header, pixels
+
+
+def decode_payload(header, payload):
+    global _prev
+    encoding = header['flags'] & 0xFF
+    width = header['width']
+    height = header['height']
+
+    if encoding == ENC_BINARY_RLE:
+        runs = np.frombuffer(payload, dtype=np.uint8)
+        colors = np.zeros(len(runs), dtype=np.uint8)
+        colors[1::2] = 255  # black, white, black, ...
+        return np.repeat(colors, runs).reshape(height, width)
+
+    if header['format'] == FORMAT_RGB565:
+        dtype = '<u2'
+        size = 2 * width * height
+    else:
+        dtype = np.uint8
+        size = width * height
+
+    if encoding == ENC_DELTA_RLE:
+        if header['flags'] & FLAG_KEY or _prev is None or len(_prev) != size:
+            if not header['flags'] & FLAG_KEY:
+                return None  # joined mid stream, wait for a key frame
+            _prev = np.zeros(size, dtype=np.uint8)
+        data = _prev.copy()
+        pos = 0
+        i = 0
+        while i < len(payload):
+            pos += payload[i]
+            count = payload[i + 1]
+            i += 2
+            data[pos:pos + count] ^= np.frombuffer(payload, dtype=np.uint8, count=count, offset=i)
+            pos += count
+            i += count
+        _prev = data
+        payload = data.tobytes()
+
+    return np.frombuffer(payload, dtype=dtype).reshape(height, width)
+
+
+def to_rgb(header, pixels):
+    """height x width x 3 uint8 image, gray for Y8 and binary"""
+    if header['format'] == FORMAT_RGB565:
+        r = ((pixels >> 11) & 0x1F) << 3
+        g = ((pixels >> 5) & 0x3F) << 2
+        b = (pixels & 0x1F) << 3
+        return np.stack((r, g, b), axis=-1).astype(np.uint8)
+    return np.stack((pixels, pixels, pixels), axis=-1)
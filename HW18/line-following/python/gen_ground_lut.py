@@ -0,0 +1,77 @@
+# Writes ground_lut.h: where each 80x60 image column and row lands on the
+# floor, for a pinhole camera at a height above the floor tilted down.
+# The image columns run forward (higher columns further ahead, as
+# SCAN_FAR_HIGH_COLUMNS in scanline.h) and the rows run sideways.
+#
+# Measure the mount and rerun when it changes:
+#   python3 gen_ground_lut.py --height 80 --tilt 35 > ../ground_lut.h
+#
+# The camera sees the floor along the ray (u, v, 1), u = (col - cx) / f
+# upwards in the image and v = (row - cy) / f sideways. Tilted down by t and
+# at height h the ray meets the floor at
+#   s = h / (sin t - u cos t)
+#   ahead = s (cos t + u sin t),  side = s v
+# so ahead only depends on the column, and side is the row offset times a
+# per column scale. Two 80 entry tables cover the whole image.
+
+import argparse
+import math
+
+WIDTH = 80   # IMAGESIZEX
+HEIGHT = 60  # IMAGESIZEY
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--height', type=float, default=80.0, help='lens above the floor, mm')
+parser.add_argument('--tilt', type=float, default=35.0, help='optical axis below horizontal, degrees')
+parser.add_argument('--fov', type=float, default=50.0, help='field of view along the image columns, degrees')
+parser.add_argument('--max', type=float, default=2000.0, help='distance used at and above the horizon, mm')
+args = parser.parse_args()
+
+t = math.radians(args.tilt)
+f = (WIDTH / 2) / math.tan(math.radians(args.fov) / 2)  # pixels
+cx = (WIDTH - 1) / 2
+cy = (HEIGHT - 1) / 2
+
+ahead = []
+perRow = []
+for col in range(WIDTH):
+    u = (col - cx) / f
+    down = math.sin(t) - u * math.cos(t)
+    s = args.height / down if down > 0 else math.inf
+    a = s * (math.cos(t) + u * math.sin(t))
+    if not a < args.max:
+        # above the horizon, or too far to matter
+        a = args.max
+        s = args.max / (math.cos(t) + u * math.sin(t)) if down > 0 else args.max
+    ahead.append(a)
+    perRow.append(s / f)
+
+def table(values, scale):
+    out = []
+    for i in range(0, len(values), 10):
+        out.append('    ' + ', '.join(str(min(65535, round(v * scale))) for v in values[i:i + 10]) + ',')
+    return '\n'.join(out)
+
+print('''#ifndef GROUND_LUT_h
+#define GROUND_LUT_h
+
+#include <stdint.h>
+
+// Generated by python/gen_ground_lut.py, do not edit.
+// height {h:g} mm, tilt {tilt:g} deg, fov {fov:g} deg
+
+#define GROUND_CENTER_ROW {cy:g} // image row straight ahead of the camera
+#define GROUND_MM_PER_ROW_MID {mid:.3f} // at column {c}
+
+// mm ahead of the lens of each image column, in 1/16 mm
+static const uint16_t groundAheadLut[{w}] = {{
+{ahead}
+}};
+
+// mm sideways per image row on each image column, in 1/256 mm
+static const uint16_t groundMmPerRowLut[{w}] = {{
+{per}
+}};
+
+#endif'''.format(h=args.height, tilt=args.tilt, fov=args.fov, cy=cy, mid=perRow[WIDTH // 2],
+                 c=WIDTH // 2, w=WIDTH, ahead=table(ahead, 16), per=table(perRow, 256)))
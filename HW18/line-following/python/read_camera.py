@@ -1,4 +1,3 @@
-
 # sudo apt-get install python3-pip
 # python3 -m pip install pyserial
 # sudo apt-get install python3-matplotlib
@@ -7,16 +6,15 @@
 import matplotlib.pyplot as plt 
 
 import serial
-ser = serial.Serial('/dev/tty.usbmodem1101')
+ser = serial.Serial('/dev/tty.usbmodem1101', timeout=2)
 print('Opening port: ')
 print(ser.name)
 
 import numpy as np
 from PIL import Image
 import matplotlib.pyplot as plt
-reds = np.zeros((60, 80), dtype=np.uint8)
-greens = np.zeros((60, 80), dtype=np.uint8)
-blues = np.zeros((60, 80), dtype=np.uint8)
+
+from frame_protocol import read_frame, to_rgb
 
 has_quit = False
 # menu loop
@@ -28,19 +26,14 @@ while not has_quit:
     ser.write(selection_endline.encode()); # .encode() turns the string into a char array
 
     if (selection == 'c'):
-        for t in range(4800):
-            dat_str = ser.read_until(b'\n'); 
-            i,r,g,b = list(map(int,dat_str.split())) 
-            row = i//80
-            col = i%80
-            reds[row][col] = r
-            greens[row][col] = g
-            blues[row][col] = b
-            print(i)
-            #print(str(i)+" "+str(r)+ " "+ str(g) + " " +str(b))
+        header, pixels = read_frame(ser)
+        if header is None:
+            print('No frame received')
+            continue
+        print('frame ' + str(header['id']) + ' at ' + str(header['timestamp']) + ' us')
 
         # Stack arrays to form an RGB image
-        rgb_array = np.stack((reds, greens, blues), axis=-1)
+        rgb_array = to_rgb(header, pixels)
 
         # Convert to an image using PIL
         image = Image.fromarray(rgb_array)
@@ -49,6 +42,45 @@ while not has_quit:
         plt.imshow(image)
         plt.axis("off")  # Hide axes
         plt.show()
+    elif (selection == 's'):
+        # pipeline stats, one line per counter / stage until "stats end"
+        while True:
+            line = ser.read_until(b'\n').decode(errors='ignore').strip()
+            if line == '':
+                print('No stats received')
+                break
+            if not line.startswith('stats'):
+                continue  # line error printed by the robot
+            words = line.split()
+            if words[1] == 'end':
+                break
+            if words[1] in ('frames', 'boot', 'cores'):
+                print(line[6:])
+            else:
+                name = words[1]
+                count, lo, avg, hi = map(int, words[2:6])
+                hist = list(map(int, words[6:]))
+                print('{:8s} n={:<7d} min={:<7d} avg={:<7d} max={:<7d} us'.format(name, count, lo, avg, hi))
+                # bin k holds [2^(k-1), 2^k) us
+                print('         ' + ' '.join(str(1 << (k - 1) if k else 0) + ':' + str(n) for k, n in enumerate(hist) if n))
+    elif (selection == 'x'):
+        # every vision kernel on one frame, one line each until "bench end"
+        #   bench frame <kernel> <cycles> ref <cycles> cycles bytes <n> agree <n>/<n>
+        while True:
+            line = ser.read_until(b'\n').decode(errors='ignore').strip()
+            if line == '':
+                print('No bench received')
+                break
+            if not line.startswith('bench'):
+                continue  # line error printed by the robot
+            words = line.split()
+            if words[1] == 'end':
+                break
+            name, cycles, ref = words[2], int(words[3]), int(words[5])
+            speedup = ' {:5.2f}x'.format(ref / cycles) if ref and cycles else ''
+            print('{:15s} {:>8d} cycles ref {:>8d}{} bytes {:>5s} agree {}'.format(name, cycles, ref, speedup, words[8], words[10]))
+    elif (selection == 'z'):
+        print('Stats zeroed')
     elif (selection == 'q'):
         print('Exiting client')
         has_quit = True; # exit client
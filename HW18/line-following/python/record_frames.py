@@ -0,0 +1,43 @@
+# Records frames from the robot for host/cam_bench and the other host tools:
+# full 80x60 RGB565 frames back to back (low byte first), the rows outside
+# the camera window black. Needs the RGB565 firmware, not CAM_LUMA_ONLY.
+# usage: python3 record_frames.py straight.raw [frames]
+
+import sys
+
+import numpy as np
+import serial
+
+from frame_protocol import read_frame, FORMAT_RGB565
+
+WIDTH = 80
+HEIGHT = 60
+
+if len(sys.argv) < 2:
+    print('usage: python3 record_frames.py out.raw [frames]')
+    sys.exit(1)
+count = int(sys.argv[2]) if len(sys.argv) > 2 else 32
+
+ser = serial.Serial('/dev/tty.usbmodem1101', timeout=2) # the name of your port here
+print('Opening port: ' + str(ser.name))
+
+# raw frames, video on
+ser.write('r\nv\n'.encode())
+got = 0
+with open(sys.argv[1], 'wb') as out:
+    while got < count:
+        header, pixels = read_frame(ser)
+        if header is None:
+            print('No frame received')
+            break
+        if header['format'] != FORMAT_RGB565:
+            print('frame ' + str(header['id']) + ' is not RGB565, skipped')
+            continue
+        frame = np.zeros((HEIGHT, WIDTH), dtype='<u2')
+        frame[header['first_row']:header['first_row'] + header['height'], :] = pixels
+        out.write(frame.tobytes())
+        got += 1
+        print('frame ' + str(header['id']) + ', ' + str(got) + ' of ' + str(count))
+# video off again
+ser.write('v\n'.encode())
+ser.close()
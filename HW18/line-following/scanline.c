@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+
+#include "scanline.h"
+
+const char *topologyNames[] = {
+    "none", "straight", "curve", "fork", "cross", "end"
+};
+
+// bright segments down one column of the frame
+static void scanColumn(const cameraFrame_t *f, scanline_t *s){
+    const uint8_t *p = f->data + s->col*CAM_BYTES_PER_PIXEL;
+    int row = 0;
+    s->count = 0;
+    while (row < f->rows && s->count < SCAN_MAX_SEGMENTS){
+        while (row < f->rows && pixelBright(p + row*CAM_ROW_BYTES) < f->threshold){
+            row++;
+        }
+        if (row == f->rows){
+            break;
+        }
+        int start = row;
+        int mass = 0;
+        int massRow = 0;
+        int b;
+        while (row < f->rows && (b = pixelBright(p + row*CAM_ROW_BYTES)) >= f->threshold){
+            mass = mass + b;
+            massRow = massRow + b*row;
+            row++;
+        }
+        if (row - start < SCAN_MIN_WIDTH){
+            continue;
+        }
+        segment_t *g = &s->seg[s->count++];
+        g->start = f->firstRow + start;
+        g->end = f->firstRow + row - 1;
+        g->mass = mass;
+        g->center = 16*f->firstRow + (16*massRow) / mass;
+    }
+    CAM_READ(row*CAM_BYTES_PER_PIXEL);
+}
+
+static int isCrossing(const frameTopology_t *topo, const segment_t *g){
+    return 2*(g->end - g->start + 1) > topo->rows;
+}
+
+void analyzeTopology(const cameraFrame_t *f, frameTopology_t *topo){
+    int k;
+    topo->rows = f->rows;
+    topo->branches = 0;
+    int seen = 0;    // scanlines with a segment
+    int cross = 0;
+    int farthest = -1;
+    for(k=0;k<CAM_FIT_LINES;k++){
+        scanline_t *s = &topo->line[k];
+        s->col = CAM_FIT_COLUMN(SCAN_FAR_HIGH_COLUMNS ? k : CAM_FIT_LINES - 1 - k);
+        scanColumn(f, s);
+        if (s->count > topo->branches){
+            topo->branches = s->count;
+        }
+        if (s->count > 0){
+            seen++;
+            farthest = k;
+        }
+        int i;
+        for(i=0;i<s->count;i++){
+            cross = cross || isCrossing(topo, &s->seg[i]);
+        }
+    }
+
+    if (seen == 0){
+        topo->type = TOPO_NONE;
+    } else if (cross){
+        topo->type = TOPO_CROSS;
+    } else if (topo->branches >= 2){
+        topo->type = TOPO_FORK;
+    } else if (farthest < CAM_FIT_LINES - TOPO_END_LINES){
+        topo->type = TOPO_END;
+    } else {
+        // one segment per scanline: curved if the middle is off the chord
+        // between the nearest and the farthest
+        const scanline_t *a = NULL;
+        const scanline_t *b = NULL;
+        for(k=0;k<CAM_FIT_LINES;k++){
+            if (topo->line[k].count == 0) continue;
+            if (a == NULL) a = &topo->line[k];
+            b = &topo->line[k];
+        }
+        int off = 0;
+        for(k=0;k<CAM_FIT_LINES && a != b;k++){
+            const scanline_t *s = &topo->line[k];
+            if (s->count == 0 || s == a || s == b) continue;
+            int chord = a->seg[0].center + (b->seg[0].center - a->seg[0].center)*(s->col - a->col) / (b->col - a->col);
+            int d = abs(s->seg[0].center - chord);
+            if (d > off) off = d;
+        }
+        topo->type = off > 16*TOPO_CURVE_ROWS ? TOPO_CURVE : TOPO_STRAIGHT;
+    }
+}
+
+int followBranch(const frameTopology_t *topo, int branch, real_t trackRow, lineFit_t *fit){
+    int x[CAM_FIT_LINES], y[CAM_FIT_LINES];
+    int n = 0;
+    int last = trackRow < 0 ? -1 : REAL_TO_INT(REAL_MUL(trackRow, REAL(16.0)));
+    int k, i;
+    for(k=0;k<CAM_FIT_LINES;k++){
+        const scanline_t *s = &topo->line[k];
+        const segment_t *pick = NULL;
+        for(i=0;i<s->count;i++){
+            const segment_t *g = &s->seg[i];
+            if (isCrossing(topo, g)){
+                continue;
+            }
+            if (pick == NULL){
+                pick = g;
+            } else if (branch == BRANCH_LOW){
+                if (g->center < pick->center) pick = g;
+            } else if (branch == BRANCH_HIGH){
+                if (g->center > pick->center) pick = g;
+            } else if (last < 0){
+                if (g->mass > pick->mass) pick = g;
+            } else if (abs(g->center - last) < abs(pick->center - last)){
+                pick = g;
+            }
+        }
+        if (pick != NULL){
+            x[n] = s->col;
+            y[n] = pick->center;
+            last = pick->center;
+            n++;
+        }
+    }
+    return fitLinePoints(x, y, n, fit);
+}
@@ -0,0 +1,68 @@
+#ifndef SCANLINE_h
+#define SCANLINE_h
+
+#include <stdint.h>
+#include "cam.h"
+
+// Every bright segment on the fitLine() columns instead of one centroid,
+// and what the segments say about the track ahead: straight, curve, a fork,
+// a crossing line or the end of the line. At a fork or crossing a policy
+// picks the branch and only that branch's segments are fitted.
+
+// 1 if higher image columns are further ahead of the robot, 0 if lower
+#ifndef SCAN_FAR_HIGH_COLUMNS
+#define SCAN_FAR_HIGH_COLUMNS 1
+#endif
+#define SCAN_MAX_SEGMENTS 6 // per scanline, more are ignored
+#define SCAN_MIN_WIDTH 2    // rows, thinner segments are noise
+#define TOPO_CURVE_ROWS 2   // middle of the line this far off the chord is a curve
+#define TOPO_END_LINES 2    // this many empty scanlines at the far end is the end
+
+typedef struct segment{
+    uint8_t start;    // first and last image row over the threshold
+    uint8_t end;
+    int mass;         // brightness over the segment
+    int center;       // brightness weighted center, 1/16 image rows
+} segment_t;
+
+typedef struct scanline{
+    int col;          // image column
+    int count;        // segments found
+    segment_t seg[SCAN_MAX_SEGMENTS];
+} scanline_t;
+
+enum {
+    TOPO_NONE = 0, // no line at all
+    TOPO_STRAIGHT,
+    TOPO_CURVE,
+    TOPO_FORK,     // one line near, two or more further ahead
+    TOPO_CROSS,    // a line across the track, a segment over half the band
+    TOPO_END       // the line stops ahead
+};
+
+// which segment to follow where a scanline has more than one
+enum {
+    BRANCH_NEAREST = 0, // closest to where the line was on the scanline before
+    BRANCH_LOW,         // lowest image row
+    BRANCH_HIGH         // highest image row
+};
+
+typedef struct frameTopology{
+    int type;
+    int branches;   // most segments on one scanline
+    int rows;       // rows in the frame, a segment over half of them is crossing
+    scanline_t line[CAM_FIT_LINES]; // nearest first
+} frameTopology_t;
+
+// picks BRANCH_* for a frame, called by the line-following loop at forks and crossings
+typedef int (*branchPolicy_t)(const frameTopology_t *topo);
+
+extern const char *topologyNames[];
+
+// segments of every fitLine() column of the frame and the frame type
+void analyzeTopology(const cameraFrame_t *f, frameTopology_t *topo);
+// fitLine() through one segment per scanline, chosen by branch, starting
+// from trackRow (< 0 for the heaviest near segment). Crossing segments are skipped.
+int followBranch(const frameTopology_t *topo, int branch, real_t trackRow, lineFit_t *fit);
+
+#endif
@@ -0,0 +1,94 @@
+#include "pico/stdlib.h"
+
+#include "tracker.h"
+
+void trackReset(lineTrack_t *t){
+    t->pos = REAL_FROM_INT(IMAGESIZEY / 2);
+    t->rate = 0;
+    t->heading = 0;
+    t->sigma = TRACK_SIGMA_LOST;
+    t->time = 0;
+    t->misses = 0;
+    t->valid = 0;
+}
+
+// uncertainty after coasting from t->time to time
+static real_t sigmaAt(const lineTrack_t *t, uint32_t time){
+    uint32_t dt = time - t->time;
+    if (dt > 1000000){
+        return TRACK_SIGMA_LOST; // over a second, and keeps the math in range
+    }
+    return t->sigma + REAL_SCALE(REAL_FROM_INT(TRACK_SIGMA_GROWTH), dt, 1000000);
+}
+
+real_t trackPredict(const lineTrack_t *t, uint32_t time){
+    if (!t->valid){
+        return t->pos;
+    }
+    uint32_t dt = time - t->time;
+    if (dt > 1000000){
+        dt = 1000000;
+    }
+    return t->pos + REAL_SCALE(t->rate, dt, 1000000);
+}
+
+real_t trackConfidence(const lineTrack_t *t, uint32_t time){
+    if (!t->valid){
+        return 0;
+    }
+    real_t sigma = sigmaAt(t, time);
+    if (sigma >= TRACK_SIGMA_LOST){
+        return 0;
+    }
+    return REAL_ONE - REAL_DIV(sigma, TRACK_SIGMA_LOST);
+}
+
+int trackUpdate(lineTrack_t *t, const lineFit_t *fit, uint32_t frameTime){
+    int usable = fit->points > 0 && fit->quality >= TRACK_MIN_QUALITY;
+
+    if (!t->valid){
+        if (!usable){
+            t->misses++;
+            return 0;
+        }
+        // first fit, or the first since the track was lost
+        t->pos = fit->offset;
+        t->rate = 0;
+        t->heading = fit->heading;
+        t->sigma = TRACK_SIGMA_FIT;
+        t->time = frameTime;
+        t->misses = 0;
+        t->valid = 1;
+        return 1;
+    }
+
+    // move the track up to this frame
+    uint32_t dt = frameTime - t->time;
+    real_t predicted = trackPredict(t, frameTime);
+    real_t sigma = sigmaAt(t, frameTime);
+
+    real_t residual = fit->offset - predicted;
+    if (!usable || REAL_ABS(residual) > TRACK_GATE + sigma){
+        // coast: keep the prediction, get less sure of it
+        t->pos = predicted;
+        t->sigma = sigma;
+        t->time = frameTime;
+        t->misses++;
+        if (sigma >= TRACK_SIGMA_LOST){
+            t->valid = 0;
+        }
+        return 0;
+    }
+
+    t->pos = predicted + REAL_MUL(TRACK_ALPHA, residual);
+    if (dt > 0){
+        t->rate = t->rate + REAL_SCALE(REAL_MUL(TRACK_BETA, residual), 1000000, dt);
+    }
+    if (t->rate > TRACK_MAX_RATE) t->rate = TRACK_MAX_RATE;
+    if (t->rate < -TRACK_MAX_RATE) t->rate = -TRACK_MAX_RATE;
+    t->heading = t->heading + REAL_MUL(TRACK_ALPHA, fit->heading - t->heading);
+    t->sigma = TRACK_SIGMA_FIT;
+    t->time = frameTime;
+    t->misses = 0;
+    return 1;
+}
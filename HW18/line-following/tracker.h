@@ -0,0 +1,41 @@
+#ifndef TRACKER_h
+#define TRACKER_h
+
+#include <stdint.h>
+#include "cam.h"
+
+// Alpha-beta filter on the line position across frames. It smooths the
+// per-frame fits, estimates how fast the line moves across the image,
+// predicts where it will be when the motors act, and coasts through frames
+// with no line (or dropped frames) with a growing uncertainty instead of
+// jumping back to the image center.
+
+#define TRACK_ALPHA REAL(0.5)          // share of the position error taken per fit
+#define TRACK_BETA REAL(0.15)          // same for the rate
+#define TRACK_SIGMA_FIT REAL(1.0)      // rows, uncertainty right after a fit
+#define TRACK_SIGMA_GROWTH 40          // rows per second of coasting
+#define TRACK_SIGMA_LOST REAL(20.0)    // rows, give up on the track here
+#define TRACK_GATE REAL(10.0)          // rows from the prediction (plus sigma) a fit may be
+#define TRACK_MAX_RATE REAL(300.0)     // rows per second
+#define TRACK_MIN_QUALITY 20           // fits below this are treated as a miss
+
+typedef struct lineTrack{
+    real_t pos;     // image row of the line at column IMAGESIZEX/2, at time
+    real_t rate;    // rows per second
+    real_t heading; // smoothed fit heading, radians
+    real_t sigma;   // uncertainty of pos in rows, at time
+    uint32_t time;  // time_us_32() of the frame pos and sigma are for
+    uint32_t misses; // frames in a row without a usable fit
+    int valid;      // 0 until the first fit and after the track is lost
+} lineTrack_t;
+
+void trackReset(lineTrack_t *t);
+// fold in the fit from a frame captured at frameTime, a fit with no points
+// or a fit outside the gate counts as a miss. Returns 1 if the fit was used.
+int trackUpdate(lineTrack_t *t, const lineFit_t *fit, uint32_t frameTime);
+// where the line will be at time, e.g. when the motors get the next duty
+real_t trackPredict(const lineTrack_t *t, uint32_t time);
+// near 1 right after a good fit, down to 0 as the track coasts towards lost
+real_t trackConfidence(const lineTrack_t *t, uint32_t time);
+
+#endif
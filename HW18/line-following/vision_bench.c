@@ -0,0 +1,509 @@
+#include <stdio.h>
+#include <math.h>
+#include "pico/stdlib.h"
+
+#include "vision_bench.h"
+#include "blob.h"
+#include "scanline.h"
+
+const char *benchNames[] = {
+    "findLine", "findLineColumn", "fitLine", "fitLineNear", "blobs", "topology", "convert"
+};
+
+#if PICO_ON_DEVICE
+#include "hardware/structs/systick.h"
+#define BENCH_UNIT "cycles"
+// SysTick on the processor clock, a 24 bit down counter, so one run of a
+// kernel at a time (over 100 ms at 150 MHz before it wraps)
+static void tickInit(void){
+    systick_hw->csr = 0;
+    systick_hw->rvr = 0xFFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5; // enable, processor clock, no interrupt
+}
+static uint32_t tickNow(void){
+    return systick_hw->cvr;
+}
+static uint32_t tickElapsed(uint32_t start){
+    return (start - systick_hw->cvr) & 0xFFFFFF;
+}
+#else
+#include <time.h>
+#define BENCH_UNIT "ns"
+static void tickInit(void){
+}
+static uint32_t tickNow(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec*1000000000ull + ts.tv_nsec);
+}
+static uint32_t tickElapsed(uint32_t start){
+    return tickNow() - start;
+}
+#endif
+
+// the reference fit, float least squares through float centers
+typedef struct refFit{
+    float offset;    // row at column IMAGESIZEX/2
+    float slope;     // rows per column
+    float heading;
+    float curvature; // rows per column squared the centers bend away from the line
+    float bend;      // mean (col - IMAGESIZEX/2)^2 of the centers
+    int points;
+} refFit_t;
+
+static const cameraFrame_t *frame; // the frame being run
+static refFit_t ref;               // its reference fit
+static refFit_t track;             // and the line alone, see refTrackFit()
+static volatile int sink;          // keeps the results from being optimized away
+
+static const uint8_t *framePixel(int row, int col){
+    return frame->data + row*CAM_ROW_BYTES + col*CAM_BYTES_PER_PIXEL;
+}
+
+// the plain versions: threshold every pixel, then the center of mass
+
+static int refRowCenter(int row){
+    int count = 0, sum = 0, i;
+    for(i=0;i<IMAGESIZEX;i++){
+        if (pixelBright(framePixel(row, i)) >= frame->threshold){
+            count++;
+            sum = sum + i;
+        }
+    }
+    return count ? sum / count : IMAGESIZEX / 2;
+}
+
+static int refColumnCenter(int col){
+    int mass = 0, sum = 0, r;
+    for(r=0;r<frame->rows;r++){
+        int b = pixelBright(framePixel(r, col));
+        if (b >= frame->threshold){
+            mass = mass + b;
+            sum = sum + b*r;
+        }
+    }
+    return mass ? frame->firstRow + sum / mass : IMAGESIZEY / 2;
+}
+
+// float least squares of row = a + b*col through n centers like
+// fitLinePoints(), and the curvature from the residuals on the part of dx*dx
+// the line can't follow, dx = col - IMAGESIZEX/2
+static void refFitPoints(const float *x, const float *y, int n, refFit_t *fit){
+    int k;
+    fit->points = n;
+    fit->offset = IMAGESIZEY / 2;
+    fit->slope = 0;
+    fit->heading = 0;
+    fit->curvature = 0;
+    fit->bend = 0;
+    if (n == 0){
+        return;
+    }
+    float sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for(k=0;k<n;k++){
+        sx = sx + x[k];
+        sy = sy + y[k];
+        sxx = sxx + x[k]*x[k];
+        sxy = sxy + x[k]*y[k];
+    }
+    float den = n*sxx - sx*sx;
+    if (den != 0){
+        fit->slope = (n*sxy - sx*sy) / den;
+    }
+    fit->offset = (sy - fit->slope*sx) / n + fit->slope*(IMAGESIZEX / 2);
+    fit->heading = atanf(fit->slope);
+    if (n < 3 || den == 0){
+        return;
+    }
+    // dx*dx less its own line fit
+    float sq = 0, sxq = 0;
+    for(k=0;k<n;k++){
+        float d = x[k] - IMAGESIZEX / 2;
+        sq = sq + d*d;
+        sxq = sxq + x[k]*d*d;
+    }
+    float qb = (n*sxq - sx*sq) / den;
+    float qa = (sq - qb*sx) / n;
+    float seq = 0, sqq = 0;
+    for(k=0;k<n;k++){
+        float d = x[k] - IMAGESIZEX / 2;
+        float e = y[k] - fit->offset - fit->slope*d;
+        float q = d*d - qa - qb*x[k];
+        seq = seq + e*q;
+        sqq = sqq + q*q;
+    }
+    if (sqq > 0){
+        fit->curvature = seq / sqq;
+    }
+    fit->bend = sq / n;
+}
+
+// row of the fit on column col, bend included
+static float refFitRow(const refFit_t *fit, int col){
+    float d = col - IMAGESIZEX / 2;
+    return fit->offset + fit->slope*d + fit->curvature*(d*d - fit->bend);
+}
+
+static void refFitLine(refFit_t *fit){
+    float x[CAM_FIT_LINES], y[CAM_FIT_LINES];
+    int n = 0, k, r;
+    for(k=0;k<CAM_FIT_LINES;k++){
+        int col = CAM_FIT_COLUMN(k);
+        float mass = 0, sum = 0;
+        for(r=0;r<frame->rows;r++){
+            int b = pixelBright(framePixel(r, col));
+            if (b >= frame->threshold){
+                mass = mass + b;
+                sum = sum + (float)b*r;
+            }
+        }
+        if (mass > 0){
+            x[n] = col;
+            y[n] = frame->firstRow + sum / mass;
+            n++;
+        }
+    }
+    refFitPoints(x, y, n, fit);
+}
+
+// the runs of line pixels down column col at least minRows long, at most REF_RUNS
+#define REF_RUNS 16
+typedef struct refRun{
+    float center; // brightness weighted, image rows
+    int rows;
+} refRun_t;
+
+static int refColumnRuns(int col, int minRows, refRun_t *run){
+    int n = 0, start = 0, r;
+    float mass = 0, sum = 0;
+    for(r=0;r<=frame->rows;r++){
+        int b = r < frame->rows ? pixelBright(framePixel(r, col)) : 0;
+        if (b >= frame->threshold){
+            if (mass == 0) start = r;
+            mass = mass + b;
+            sum = sum + (float)b*r;
+        } else if (mass > 0){
+            if (n < REF_RUNS && r - start >= minRows){
+                run[n].center = frame->firstRow + sum / mass;
+                run[n].rows = r - start;
+                n++;
+            }
+            mass = 0;
+            sum = 0;
+        }
+    }
+    return n;
+}
+
+// The line alone: the columns with a single run of line pixels place it,
+// and on every column the run nearest there is the line's, so glare or
+// floor noise beside it stays out. What fitLineNear() and the track blob
+// should give.
+static void refTrackFit(refFit_t *fit){
+    refRun_t runs[CAM_FIT_LINES][REF_RUNS];
+    int count[CAM_FIT_LINES];
+    float x[CAM_FIT_LINES], y[CAM_FIT_LINES];
+    int n = 0, k, i;
+    for(k=0;k<CAM_FIT_LINES;k++){
+        count[k] = refColumnRuns(CAM_FIT_COLUMN(k), 1, runs[k]);
+        if (count[k] == 1){
+            x[n] = CAM_FIT_COLUMN(k);
+            y[n] = runs[k][0].center;
+            n++;
+        }
+    }
+    refFit_t single;
+    refFitPoints(x, y, n, &single);
+    if (n == 0){
+        *fit = single;
+        return;
+    }
+    n = 0;
+    for(k=0;k<CAM_FIT_LINES;k++){
+        if (count[k] == 0){
+            continue;
+        }
+        float want = refFitRow(&single, CAM_FIT_COLUMN(k));
+        int best = 0;
+        for(i=1;i<count[k];i++){
+            if (fabsf(runs[k][i].center - want) < fabsf(runs[k][best].center - want)) best = i;
+        }
+        x[n] = CAM_FIT_COLUMN(k);
+        y[n] = runs[k][best].center;
+        n++;
+    }
+    refFitPoints(x, y, n, fit);
+}
+
+// analyzeTopology()'s rules on float run centers: a run over half the
+// rows is a crossing line, two runs on a column a fork, a line that stops
+// TOPO_END_LINES columns short of the far end the end, and one whose
+// middle columns are more than TOPO_CURVE_ROWS off the chord a curve
+static int refTopology(void){
+    float center[CAM_FIT_LINES];
+    int seen[CAM_FIT_LINES];
+    int lines = 0, branches = 0, cross = 0, farthest = -1;
+    int k, i;
+    for(k=0;k<CAM_FIT_LINES;k++){
+        refRun_t runs[REF_RUNS];
+        int n = refColumnRuns(CAM_FIT_COLUMN(SCAN_FAR_HIGH_COLUMNS ? k : CAM_FIT_LINES - 1 - k), SCAN_MIN_WIDTH, runs);
+        for(i=0;i<n;i++){
+            cross = cross || 2*runs[i].rows > frame->rows;
+        }
+        if (n > branches) branches = n;
+        seen[k] = n > 0;
+        if (n > 0){
+            center[k] = runs[0].center;
+            lines++;
+            farthest = k;
+        }
+    }
+    if (lines == 0) return TOPO_NONE;
+    if (cross) return TOPO_CROSS;
+    if (branches >= 2) return TOPO_FORK;
+    if (farthest < CAM_FIT_LINES - TOPO_END_LINES) return TOPO_END;
+    int a = -1, b = -1;
+    for(k=0;k<CAM_FIT_LINES;k++){
+        if (!seen[k]) continue;
+        if (a < 0) a = k;
+        b = k;
+    }
+    float off = 0;
+    for(k=a+1;k<b;k++){
+        if (!seen[k]) continue;
+        float chord = center[a] + (center[b] - center[a])*(k - a) / (b - a);
+        if (fabsf(center[k] - chord) > off) off = fabsf(center[k] - chord);
+    }
+    return off > TOPO_CURVE_ROWS ? TOPO_CURVE : TOPO_STRAIGHT;
+}
+
+static real_t toReal(float x){
+    return (real_t)(x * REAL_ONE);
+}
+
+static int fitAgrees(const lineFit_t *fit, const refFit_t *want, float rows, float radians){
+    return fit->points > 0 && want->points > 0 &&
+        fabsf(REAL_TO_FLOAT(fit->offset) - want->offset) <= rows &&
+        fabsf(REAL_TO_FLOAT(fit->heading) - want->heading) <= radians;
+}
+
+// one frame's worth of each kernel
+
+static void runFindLine(void){
+    int r;
+    for(r=0;r<frame->rows;r++){
+        sink = sink + findLine(frame->firstRow + r);
+    }
+}
+
+static void runRefFindLine(void){
+    int r;
+    for(r=0;r<frame->rows;r++){
+        sink = sink + refRowCenter(r);
+    }
+}
+
+static void runFindLineColumn(void){
+    int c;
+    for(c=0;c<IMAGESIZEX;c++){
+        sink = sink + findLineColumn(c);
+    }
+}
+
+static void runRefFindLineColumn(void){
+    int c;
+    for(c=0;c<IMAGESIZEX;c++){
+        sink = sink + refColumnCenter(c);
+    }
+}
+
+static void runFitLine(void){
+    lineFit_t fit;
+    sink = sink + fitLine(&fit);
+}
+
+static void runRefFitLine(void){
+    refFit_t fit;
+    refFitLine(&fit);
+    sink = sink + fit.points;
+}
+
+static void runRefTrackFit(void){
+    refFit_t fit;
+    refTrackFit(&fit);
+    sink = sink + fit.points;
+}
+
+// as if last frame's line was this frame's line alone
+static int fitNear(lineFit_t *fit){
+    real_t row = track.points ? toReal(track.offset) : REAL_FROM_INT(IMAGESIZEY / 2);
+    return fitLineNear(fit, row, toReal(track.slope), toReal(track.curvature));
+}
+
+static void runFitLineNear(void){
+    lineFit_t fit;
+    sink = sink + fitNear(&fit);
+}
+
+// the blob continuing the line alone, NULL for none
+static const blob_t *trackBlob(lineFit_t *fit){
+    const blob_t *b = pickTrackBlob(findBlobs(frame), track.points ? toReal(track.offset) : REAL_FROM_INT(-1));
+    if (b != NULL){
+        blobFitLine(b, fit);
+    }
+    return b;
+}
+
+static void runBlobs(void){
+    lineFit_t fit;
+    sink = sink + (trackBlob(&fit) != NULL);
+}
+
+static void runTopology(void){
+    static frameTopology_t topo;
+    analyzeTopology(frame, &topo);
+    sink = sink + topo.type;
+}
+
+static void runRefTopology(void){
+    sink = sink + refTopology();
+}
+
+#if CAM_DEBUG_RGB
+static void runConvert(void){
+    convertImage();
+}
+#endif
+
+typedef void (*benchRun_t)(void);
+
+static const benchRun_t runs[BENCH_COUNT] = {
+    runFindLine, runFindLineColumn, runFitLine, runFitLineNear, runBlobs, runTopology,
+#if CAM_DEBUG_RGB
+    runConvert
+#else
+    NULL
+#endif
+};
+
+// the reference the answers are checked against, also timed where it is
+// the same work done the plain way
+static const benchRun_t refRuns[BENCH_COUNT] = {
+    runRefFindLine, runRefFindLineColumn, runRefFitLine, runRefTrackFit, runRefTrackFit, runRefTopology, NULL
+};
+
+// -1 if there is nothing to compare, else 1 if the kernel's answer on the
+// frame is the reference's
+static int check(int k){
+    lineFit_t fit;
+    int i;
+    switch (k){
+    case BENCH_FIND_LINE:
+        for(i=0;i<frame->rows;i++){
+            if (findLine(frame->firstRow + i) != refRowCenter(i)) return 0;
+        }
+        return 1;
+    case BENCH_FIND_LINE_COLUMN:
+        for(i=0;i<IMAGESIZEX;i++){
+            if (findLineColumn(i) != refColumnCenter(i)) return 0;
+        }
+        return 1;
+    case BENCH_FIT_LINE:
+        fitLine(&fit);
+        return fit.points == ref.points && (ref.points == 0 || fitAgrees(&fit, &ref, 0.25f, 0.02f));
+    // glare or floor noise the plain fit takes in are outside the window
+    // or blobs of their own, so these two are checked against the line alone
+    case BENCH_FIT_LINE_NEAR:
+        // falling back to the full scan is no answer
+        if (fitNear(&fit) == 0) return -1;
+        return fitAgrees(&fit, &track, 0.5f, 0.05f);
+    case BENCH_BLOBS:
+        if (trackBlob(&fit) == NULL) return track.points == 0;
+        return fitAgrees(&fit, &track, 1.0f, 0.05f);
+    case BENCH_TOPOLOGY:{
+        frameTopology_t topo;
+        analyzeTopology(frame, &topo);
+        return topo.type == refTopology();
+    }
+#if CAM_DEBUG_RGB
+    case BENCH_CONVERT:
+        convertImage();
+        for(i=0;i<frame->rows*IMAGESIZEX;i++){
+            int row = i / IMAGESIZEX, col = i % IMAGESIZEX;
+            const uint8_t *p = framePixel(row, col);
+            uint8_t r, g, b;
+            getPixel(frame->firstRow + row, col, &r, &g, &b);
+#if CAM_LUMA_ONLY
+            if (r != p[0] || g != p[0] || b != p[0]) return 0;
+#else
+            if (r != ((p[1]>>3)<<3) || g != ((((p[1]&0b111)<<3) | p[0]>>5)<<2) || b != ((p[0]&0b11111)<<3)) return 0;
+#endif
+        }
+        return 1;
+#endif
+    }
+    return -1;
+}
+
+static uint64_t timeRun(benchRun_t run, int reps){
+    uint64_t total = 0;
+    int i;
+    for(i=0;i<reps;i++){
+        uint32_t t0 = tickNow();
+        run();
+        total = total + tickElapsed(t0);
+    }
+    return total / reps;
+}
+
+void benchReset(visionBench_t *b){
+    int k;
+    for(k=0;k<BENCH_COUNT;k++){
+        b->kernel[k] = (benchKernel_t){0};
+    }
+}
+
+void benchFrame(visionBench_t *b, const cameraFrame_t *f, int reps){
+    int k;
+    if (reps < 1) reps = 1;
+    tickInit();
+    frame = f;
+    refFitLine(&ref);
+    refTrackFit(&track);
+    for(k=0;k<BENCH_COUNT;k++){
+        benchKernel_t *bk = &b->kernel[k];
+        if (runs[k] == NULL){
+            continue;
+        }
+#if CAM_COUNT_READS
+        camBytesRead = 0;
+        runs[k]();
+        bk->bytes = bk->bytes + camBytesRead;
+#endif
+        bk->ticks = bk->ticks + timeRun(runs[k], reps);
+        if (refRuns[k] != NULL){
+            bk->refTicks = bk->refTicks + timeRun(refRuns[k], reps);
+        }
+        int same = check(k);
+        if (same >= 0){
+            bk->checked++;
+            bk->agree = bk->agree + same;
+        }
+        bk->frames++;
+    }
+}
+
+void benchPrint(const visionBench_t *b, const char *corpus){
+    int k;
+    for(k=0;k<BENCH_COUNT;k++){
+        const benchKernel_t *bk = &b->kernel[k];
+        if (bk->frames == 0){
+            continue;
+        }
+        printf("bench %s %s %lu ref %lu %s bytes %lu agree %lu/%lu\r\n", corpus, benchNames[k],
+            (unsigned long)(bk->ticks / bk->frames), (unsigned long)(bk->refTicks / bk->frames), BENCH_UNIT,
+            (unsigned long)(bk->bytes / bk->frames), (unsigned long)bk->agree, (unsigned long)bk->checked);
+    }
+    printf("bench end\r\n");
+}
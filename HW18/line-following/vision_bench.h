@@ -0,0 +1,47 @@
+#ifndef VISION_BENCH_h
+#define VISION_BENCH_h
+
+#include <stdint.h>
+#include "cam.h"
+
+// Times every vision kernel on a frame against a plain reference version
+// of it, counts the frame bytes it reads and checks that it gives the
+// reference's answer. The robot runs it on the current frame ('x' over USB,
+// clock cycles from SysTick), host/cam_bench on a recorded corpus (ns).
+// Build with CAM_COUNT_READS=1 for the byte counts.
+
+enum {
+    BENCH_FIND_LINE = 0,  // findLine() on every row of the frame
+    BENCH_FIND_LINE_COLUMN, // findLineColumn() on every column
+    BENCH_FIT_LINE,       // fitLine()
+    BENCH_FIT_LINE_NEAR,  // fitLineNear() around the line alone, bend included
+    BENCH_BLOBS,          // findBlobs(), pickTrackBlob() and blobFitLine()
+    BENCH_TOPOLOGY,       // analyzeTopology()
+    BENCH_CONVERT,        // convertImage(), CAM_DEBUG_RGB builds only
+    BENCH_COUNT
+};
+
+typedef struct benchKernel{
+    uint64_t ticks;    // per frame, summed over frames
+    uint64_t refTicks; // the same for the reference, 0 without one
+    uint64_t bytes;    // frame bytes read, summed over frames
+    uint32_t frames;   // frames run
+    uint32_t checked;  // frames with an answer to compare, fitLineNear() falling back has none
+    uint32_t agree;    // frames that gave the reference's answer
+} benchKernel_t;
+
+typedef struct visionBench{
+    benchKernel_t kernel[BENCH_COUNT];
+} visionBench_t;
+
+extern const char *benchNames[];
+
+void benchReset(visionBench_t *b);
+// run every kernel reps times on f, which has to be the frame from the last
+// acquireFrame(), and add it to b
+void benchFrame(visionBench_t *b, const cameraFrame_t *f, int reps);
+// one line per kernel, per frame averages, then "bench end"
+//   bench <corpus> <kernel> <ticks> ref <ticks> <unit> bytes <n> agree <n>/<n>
+void benchPrint(const visionBench_t *b, const char *corpus);
+
+#endif